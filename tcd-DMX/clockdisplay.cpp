@@ -12,6 +12,7 @@
 #include <Wire.h>
 
 #include "clockdisplay.h"
+#include "tc_trace.h"
 #include "tc_font.h"
 
 #define CD_MONTH_POS  0
@@ -32,15 +33,39 @@ static const char months[12][4] = {
 
 static const char *nullStr = "";
 
+#ifdef TC_SOFTDIM
+// Software dimming: Field of each column, and the bits kept when
+// the field is blanked (AM/PM, colon, year dot; the digits never
+// use bit 7 of a byte)
+static const uint8_t  TC_DRAM colField[CD_BUF_SIZE] = {
+    CDF_MONTH, CDF_MONTH, CDF_MONTH, CDF_DAY, CDF_YEAR, CDF_YEAR, CDF_HOUR, CDF_MIN
+};
+static const uint16_t TC_DRAM colKeep[CD_BUF_SIZE] = {
+    0, 0, 0, 0x8080, 0x8080, 0x8000, 0, 0
+};
+#endif
+
+// Currently selected multiplexer channel and number of channel
+// changes, shared by all displays on the same bus (Wire, Wire1).
+// Not locked: Each bus is only accessed by one task at a time (the
+// DMX loop; with TC_I2C_SPLIT, bus 1 is handed to the bus 1 task
+// and back through task notifications, see showDisplays()), so the
+// channel selection and the following transaction can't interleave
+// with another task's.
+static uint8_t  muxCur[2] = { CD_NO_MUX, CD_NO_MUX };
+static uint32_t muxSwitches[2] = { 0, 0 };
+
 /*
  * ClockDisplay class
  */
 
-// Store i2c address and display ID
-clockDisplay::clockDisplay(uint8_t did, uint8_t address)
+// Store i2c address, display ID, multiplexer channel and bus
+clockDisplay::clockDisplay(uint8_t did, uint8_t address, uint8_t mux, TwoWire *bus)
 {
     _did = did;
     _address = address;
+    _mux = mux;
+    _bus = bus;
 }
 
 // Start the display
@@ -83,17 +108,19 @@ void clockDisplay::onBlink(uint8_t blink)
 // Used for effects and brightness keypad menu
 void clockDisplay::lampTest(bool randomize)
 {
-    Wire.beginTransmission(_address);
-    Wire.write(0x00);  // start address
+    beginTransmission();
+    write(0x00);  // start address
 
     uint32_t rnd = esp_random();
 
     for(int i = 0; i < CD_BUF_SIZE; i++) {
-        Wire.write(randomize ? ((rand() % 0x7f) ^ rnd) & 0x7f : 0xaa);
-        Wire.write(randomize ? (((rand() % 0x7f) ^ (rnd >> 8))) & 0x77 : 0x55);
+        write(randomize ? ((rand() % 0x7f) ^ rnd) & 0x7f : 0xaa);
+        write(randomize ? (((rand() % 0x7f) ^ (rnd >> 8))) & 0x77 : 0x55);
     }
     
-    Wire.endTransmission();
+    endTransmission();
+
+    _shadowValid = false;
 }
 
 // Clear the buffer
@@ -160,6 +187,28 @@ bool clockDisplay::isRTC()
     return _rtc;
 }
 
+uint32_t clockDisplay::getI2CErrors()
+{
+    return _i2cErrors;
+}
+
+// Number of multiplexer channel changes
+uint32_t clockDisplay::getMuxSwitches()
+{
+    return muxSwitches[0] + muxSwitches[1];
+}
+
+// Bus traffic: Bytes (including address bytes) and transactions
+uint32_t clockDisplay::getBusBytes()
+{
+    return _busBytes;
+}
+
+uint32_t clockDisplay::getBusTransactions()
+{
+    return _busTransactions;
+}
+
 
 // Setup date in buffer --------------------------------------------------------
 
@@ -192,6 +241,68 @@ void clockDisplay::getToParms(int& year, int& month, int& day, int& hour, int& m
     minute = getMinute();
 }
 
+// Copy the rendered state (buffer, brightness, flags) to an image
+void clockDisplay::getImage(clockImage *img)
+{
+    setFlagsInBuf();
+
+    memcpy(img->buf, _displayBuffer, sizeof(img->buf));
+    img->brightness = _brightness;
+    img->flags = (isOn       ? CDI_ON    : 0) |
+                 (_colon     ? CDI_COLON : 0) |
+                 (colonBlink ? CDI_BLINK : 0) |
+                 (!_isPM     ? CDI_AM    : 0) |
+                 (_isPM > 0  ? CDI_PM    : 0);
+}
+
+// Restore the rendered state from an image; no bus access
+// except for brightness. Call show() and on()/off() after this.
+void clockDisplay::setImage(const clockImage *img)
+{
+    memcpy(_displayBuffer, img->buf, sizeof(_displayBuffer));
+    setBrightness(img->brightness);
+    isOn = !!(img->flags & CDI_ON);
+    _colon = !!(img->flags & CDI_COLON);
+    colonBlink = !!(img->flags & CDI_BLINK);
+    _isPM = (img->flags & CDI_PM) ? 1 : ((img->flags & CDI_AM) ? 0 : -1);
+}
+
+// Set the buffer from raw display RAM contents (two bytes per
+// column, low byte first). With rawMode, colon and AM/PM are
+// not put into the buffer when shown.
+void TC_IRAM clockDisplay::setRaw(const uint8_t *src)
+{
+    for(int i = 0; i < CD_BUF_SIZE; i++) {
+        _displayBuffer[i] = src[i * 2] | (src[i * 2 + 1] << 8);
+    }
+}
+
+#ifdef TC_SOFTDIM
+// Software dimming: A field is shown in PWM steps below its
+// level (0 = always blank, >= number of steps = always on)
+void clockDisplay::setFieldLevel(int field, uint8_t level)
+{
+    _fieldLevel[field] = level;
+}
+
+// Enter a PWM step; returns true if the display needs to be
+// shown as fields were blanked or restored
+bool TC_IRAM clockDisplay::setDimStep(uint8_t step)
+{
+    uint8_t vis = 0;
+
+    for(int f = 0; f < CDF_NUM; f++) {
+        if(_fieldLevel[f] > step) vis |= (1 << f);
+    }
+
+    if(vis == _fieldsVisible)
+        return false;
+
+    _fieldsVisible = vis;
+    return true;
+}
+#endif
+
 
 // Show data in display --------------------------------------------------------
 
@@ -202,6 +313,42 @@ void clockDisplay::show()
     showInt(false);
 }
 
+// Show the buffer, but only transmit the columns which differ
+// from what was last written to the display
+void TC_IRAM clockDisplay::showChanged()
+{
+    int first, last;
+
+    if(!_shadowValid) {
+        showInt(false);
+        return;
+    }
+
+    setFlagsInBuf();
+
+    for(first = 0; first < CD_BUF_SIZE; first++) {
+        if(dimWord(first) != _shadowBuffer[first]) break;
+    }
+    if(first == CD_BUF_SIZE)
+        return;
+
+    for(last = CD_BUF_SIZE - 1; last > first; last--) {
+        if(dimWord(last) != _shadowBuffer[last]) break;
+    }
+
+    beginTransmission();
+    write(first * 2);
+    for(int i = first; i <= last; i++) {
+        uint16_t w = dimWord(i);
+        write(w & 0xff);
+        write(w >> 8);
+        _shadowBuffer[i] = w;
+    }
+    if(endTransmission()) {
+        _shadowValid = false;
+    }
+}
+
 // Show all but month
 void clockDisplay::showAnimate1()
 {
@@ -211,19 +358,21 @@ void clockDisplay::showAnimate1()
 // Show month, assumes showAnimate1() was called before
 void clockDisplay::showAnimate2()
 {
-    Wire.beginTransmission(_address);
-    Wire.write(0x00);
+    beginTransmission();
+    write(0x00);
     for(int i = 0; i < CD_BUF_SIZE; i++) {
-        Wire.write(_displayBuffer[i] & 0xff);
-        Wire.write(_displayBuffer[i] >> 8);
+        write(_displayBuffer[i] & 0xff);
+        write(_displayBuffer[i] >> 8);
     }
-    Wire.endTransmission();
+    endTransmission();
+
+    _shadowValid = false;
 }
 
 // Set fields in buffer --------------------------------------------------------
 
 
-void clockDisplay::setMonth(int monthNum)
+void TC_IRAM clockDisplay::setMonth(int monthNum)
 {
     if(!monthNum) {
         _displayBuffer[CD_MONTH_POS]     = 0;
@@ -244,7 +393,7 @@ void clockDisplay::setMonth(int monthNum)
     _displayBuffer[CD_MONTH_POS + 2] = getLEDAlphaChar(months[monthNum][2]);
 }
 
-void clockDisplay::setDay(int dayNum)
+void TC_IRAM clockDisplay::setDay(int dayNum)
 {
     if(!dayNum) {
         _displayBuffer[CD_DAY_POS] = 0;
@@ -271,7 +420,7 @@ void clockDisplay::setYear(uint16_t yearNum)
     _displayBuffer[CD_YEAR_POS + 1] = makeNum(yearNum % 100);
 }
 
-void clockDisplay::setYearDigits(uint8_t d1, uint8_t d2, uint8_t d3, uint8_t d4)
+void TC_IRAM clockDisplay::setYearDigits(uint8_t d1, uint8_t d2, uint8_t d3, uint8_t d4)
 {
     uint16_t seg = 0;
 
@@ -311,7 +460,7 @@ void clockDisplay::setHour(uint16_t hourNum)
     // AM/PM will be set on show() to avoid being overwritten
 }
 
-void clockDisplay::setHour12(uint16_t hourNum)
+void TC_IRAM clockDisplay::setHour12(uint16_t hourNum)
 {
     if(!hourNum) {
         _displayBuffer[CD_HOUR_POS] = 0;
@@ -321,7 +470,7 @@ void clockDisplay::setHour12(uint16_t hourNum)
     _displayBuffer[CD_HOUR_POS] = makeNum(hourNum - 1);
 }
 
-void clockDisplay::setMinute(int minNum)
+void TC_IRAM clockDisplay::setMinute(int minNum)
 {
     if(!minNum) {
         _displayBuffer[CD_MIN_POS] = 0;
@@ -339,7 +488,7 @@ void clockDisplay::setMinute(int minNum)
     _displayBuffer[CD_MIN_POS] = makeNum(minNum);
 }
 
-void clockDisplay::setAMPM(int isPM)
+void TC_IRAM clockDisplay::setAMPM(int isPM)
 {
     // -1 = off
     // 0  = am
@@ -347,7 +496,7 @@ void clockDisplay::setAMPM(int isPM)
     _isPM = isPM;
 }
 
-void clockDisplay::setColon(bool col)
+void TC_IRAM clockDisplay::setColon(bool col)
 {
     // set true to turn it on
     // colon is on in night mode
@@ -480,36 +629,22 @@ void clockDisplay::showMinuteDirect(int minuteNum, uint16_t dflags)
 // Show the given text
 void clockDisplay::showTextDirect(const char *text, uint16_t flags)
 {
-    int idx = 0, pos = CD_MONTH_POS;
-    int temp = 0;
+    uint16_t buf[CD_BUF_SIZE];
+    int cols = makeText(text, buf, flags);
 
-    _corr6 = (flags & CDT_CORR6) ? true : false;
-    _withColon = (flags & CDT_COLON) ? true : false;
-
-    while(text[idx] && pos < (CD_MONTH_POS+CD_MONTH_SIZE)) {
-        directCol(pos++, getLEDAlphaChar(text[idx++]));
+    beginTransmission();
+    write(CD_MONTH_POS * 2);
+    for(int i = 0; i < cols; i++) {
+        write(buf[i] & 0xff);
+        write(buf[i] >> 8);
     }
-
-    while(pos < CD_DAY_POS) {
-        directCol(pos++, 0);
-    }
-    
-    pos = CD_DAY_POS;
-    while(text[idx] && pos <= CD_MIN_POS) {
-        temp = getLED7AlphaChar(text[idx++]);
-        if(text[idx]) {
-            temp |= (getLED7AlphaChar(text[idx++]) << 8);
-        }
-        directCol(pos++, temp);
-    }
-
-    if(flags & CDT_CLEAR) {
-        while(pos <= CD_MIN_POS) {
-            directCol(pos++, 0);
+    if(!endTransmission()) {
+        for(int i = 0; i < cols; i++) {
+            _shadowBuffer[i] = buf[i];
         }
+    } else {
+        _shadowValid = false;
     }
-    
-    _corr6 = _withColon = false;
 }
 
 
@@ -521,7 +656,7 @@ void clockDisplay::showTextDirect(const char *text, uint16_t flags)
 
 // Returns bit pattern for provided value 0-9 or number provided as a char '0'-'9'
 // for display on 7 segment display
-uint8_t clockDisplay::getLED7NumChar(uint8_t value)
+uint8_t TC_IRAM clockDisplay::getLED7NumChar(uint8_t value)
 {
     if(value >= '0' && value <= '9') {
         return numDigs[value - 32];
@@ -532,7 +667,7 @@ uint8_t clockDisplay::getLED7NumChar(uint8_t value)
 }
   
 // Returns bit pattern for provided character for display on 7 segment display
-uint8_t clockDisplay::getLED7AlphaChar(uint8_t value)
+uint8_t TC_IRAM clockDisplay::getLED7AlphaChar(uint8_t value)
 {
     if(value < 32 || value >= 127 + 2)
         return 0;
@@ -556,9 +691,53 @@ uint16_t clockDisplay::getLEDAlphaChar(uint8_t value)
     return alphaChars[value - 32];
 }
 
+// Build the segment data for a text; returns number of columns
+// (without CDT_CLEAR, columns after the text are to be left untouched)
+int clockDisplay::makeText(const char *text, uint16_t *buf, uint16_t flags)
+{
+    int idx = 0, pos = CD_MONTH_POS;
+    int temp = 0;
+
+    _corr6 = (flags & CDT_CORR6) ? true : false;
+
+    while(text[idx] && pos < (CD_MONTH_POS+CD_MONTH_SIZE)) {
+        buf[pos++] = getLEDAlphaChar(text[idx++]);
+    }
+
+    while(pos < CD_DAY_POS) {
+        buf[pos++] = 0;
+    }
+    
+    pos = CD_DAY_POS;
+    while(text[idx] && pos <= CD_MIN_POS) {
+        temp = getLED7AlphaChar(text[idx++]);
+        if(text[idx]) {
+            temp |= (getLED7AlphaChar(text[idx++]) << 8);
+        }
+        buf[pos++] = temp;
+    }
+
+    if(flags & CDT_CLEAR) {
+        while(pos <= CD_MIN_POS) {
+            buf[pos++] = 0;
+        }
+    }
+
+    if(pos > CD_YEAR_POS + 1 && _yearDot) {
+        buf[CD_YEAR_POS + 1] |= 0x8000;
+    }
+    if(pos > CD_YEAR_POS && (flags & CDT_COLON)) {
+        buf[CD_YEAR_POS] |= 0x8080;
+    }
+    
+    _corr6 = false;
+
+    return pos;
+}
+
 // Make a 2 digit number from the array and return the segment data
 // (makes leading 0s)
-uint16_t clockDisplay::makeNum(uint8_t num, uint16_t dflags)
+uint16_t TC_IRAM clockDisplay::makeNum(uint8_t num, uint16_t dflags)
 {
     uint16_t segments = 0;
 
@@ -582,60 +761,95 @@ void clockDisplay::directCol(int col, int segments)
     } else if((col == CD_YEAR_POS) && _withColon) {
         segments |= 0x8080;
     }
-    Wire.beginTransmission(_address);
-    Wire.write(col * 2);
-    Wire.write(segments & 0xff);
-    Wire.write(segments >> 8);
-    Wire.endTransmission();
+    beginTransmission();
+    write(col * 2);
+    write(segments & 0xff);
+    write(segments >> 8);
+    endTransmission();
+
+    _shadowBuffer[col] = segments;
 }
 
 // Directly clear the display
 void clockDisplay::clearDisplay()
 {
-    Wire.beginTransmission(_address);
-    Wire.write(0x00);
+    beginTransmission();
+    write(0x00);
 
     for(int i = 0; i < CD_BUF_SIZE*2; i++) {
-        Wire.write(0x00);
+        write(0x00);
     }
 
-    Wire.endTransmission();
+    _shadowValid = !endTransmission();
+
+    for(int i = 0; i < CD_BUF_SIZE; i++) {
+        _shadowBuffer[i] = 0;
+    }
 }
 
 // Show the buffer
-void clockDisplay::showInt(bool animate, bool Alt)
+void TC_IRAM clockDisplay::showInt(bool animate, bool Alt)
 {
     int i = 0;
     uint16_t *db = _displayBuffer;
 
     if(animate) off();
 
-    if(_isPM > 0)   PM();
-    else if(!_isPM) AM();
-    else            AMPMoff();
-
-    (_colon) ? colonOn() : colonOff();
+    setFlagsInBuf();
 
-    Wire.beginTransmission(_address);
-    Wire.write(0x00);
+    beginTransmission();
+    write(0x00);
 
     if(animate) {
         for(i = 0; i < CD_DAY_POS; i++) {
-            Wire.write(0x00);  // blank month
-            Wire.write(0x00);
+            write(0x00);  // blank month
+            write(0x00);
         }
     }
 
     for(; i < CD_BUF_SIZE; i++) {
-        Wire.write(db[i] & 0xff);
-        Wire.write(db[i] >> 8);
+        uint16_t w = dimWord(i);
+        write(w & 0xff);
+        write(w >> 8);
     }
 
-    Wire.endTransmission();
+    if(!endTransmission()) {
+        for(i = 0; i < CD_BUF_SIZE; i++) {
+            _shadowBuffer[i] = (animate && i < CD_DAY_POS) ? 0 : dimWord(i);
+        }
+        _shadowValid = true;
+    } else {
+        _shadowValid = false;
+    }
 
     if(animate) on();
 }
 
+// Column as written to display RAM: Blanked if its field is
+// dimmed out in the current PWM step
+uint16_t TC_IRAM clockDisplay::dimWord(int col)
+{
+    #ifdef TC_SOFTDIM
+    if(!(_fieldsVisible & (1 << colField[col]))) {
+        return _displayBuffer[col] & colKeep[col];
+    }
+    #endif
+    return _displayBuffer[col];
+}
+
+// Put AM/PM and colon into buffer
+void TC_IRAM clockDisplay::setFlagsInBuf()
+{
+    if(rawMode)
+        return;
+
+    if(_isPM > 0)   PM();
+    else if(!_isPM) AM();
+    else            AMPMoff();
+
+    (_colon) ? colonOn() : colonOff();
+}
+
 void clockDisplay::colonOn()
 {
     _displayBuffer[CD_COLON_POS] |= 0x8080;
@@ -675,11 +889,13 @@ void clockDisplay::AMPMoff()
 
 void clockDisplay::directAMPM(int val1, int val2)
 {
-    Wire.beginTransmission(_address);
-    Wire.write(CD_AMPM_POS * 2);
-    Wire.write(val1 & 0xff);
-    Wire.write(val2 & 0xff);
-    Wire.endTransmission();
+    beginTransmission();
+    write(CD_AMPM_POS * 2);
+    write(val1 & 0xff);
+    write(val2 & 0xff);
+    endTransmission();
+
+    _shadowBuffer[CD_AMPM_POS] = (val1 & 0xff) | ((val2 & 0xff) << 8);
 }
 
 void clockDisplay::directAM()
@@ -707,7 +923,58 @@ void clockDisplay::directAMPMoff()
 
 void clockDisplay::directCmd(uint8_t val)
 {
-    Wire.beginTransmission(_address);
-    Wire.write(val);
-    Wire.endTransmission();
+    beginTransmission();
+    write(val);
+    endTransmission();
+}
+
+// Select our multiplexer channel (if not already selected)
+// and start a transmission to the display
+void TC_IRAM clockDisplay::beginTransmission()
+{
+    int      bus = (_bus == &Wire) ? 0 : 1;
+    uint8_t& cur = muxCur[bus];
+    uint8_t  ret;
+
+    if(_mux != cur) {
+        _bus->beginTransmission(TC_MUX_ADDR);
+        _bus->write(1 << _mux);
+        TRACE_BEGIN(TR_I2C, TC_MUX_ADDR);
+        ret = _bus->endTransmission();
+        TRACE_END(TR_I2C, TR_I2C_ARG(TC_MUX_ADDR, bus, 1, 0));
+        _busBytes += 2;
+        _busTransactions++;
+        if(ret) {
+            _i2cErrors++;
+            cur = CD_NO_MUX;
+        } else {
+            cur = _mux;
+        }
+        muxSwitches[bus]++;
+    }
+
+    _bus->beginTransmission(_address);
+    _txStart = _busBytes;
+}
+
+void TC_IRAM clockDisplay::write(uint8_t val)
+{
+    _bus->write(val);
+    _busBytes++;
+}
+
+uint8_t TC_IRAM clockDisplay::endTransmission()
+{
+    uint8_t ret;
+
+    TRACE_BEGIN(TR_I2C, _address);
+    ret = _bus->endTransmission();
+    TRACE_END(TR_I2C, TR_I2C_ARG(_address, (_bus == &Wire) ? 0 : 1, _busBytes - _txStart, 0));
+
+    _busBytes++;            // Address
+    _busTransactions++;
+
+    if(ret) _i2cErrors++;
+
+    return ret;
 }
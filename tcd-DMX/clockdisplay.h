@@ -11,6 +11,8 @@
 
 //#include "rtc.h"
 
+#include <Wire.h>
+
 struct dateStruct {
     uint16_t year;
     uint8_t month;
@@ -31,11 +33,41 @@ struct dateStruct {
 #define CDD_FORCE24 0x0001
 #define CDD_NOLEAD0 0x0002
 
+// Rendered state of a display (scenes)
+struct clockImage {
+    uint16_t buf[CD_BUF_SIZE];  // including colon and AM/PM
+    uint8_t  brightness;
+    uint8_t  flags;             // CDI_xxx
+};
+
+// Flags for clockImage
+#define CDI_ON    0x01
+#define CDI_COLON 0x02
+#define CDI_BLINK 0x04
+#define CDI_AM    0x08
+#define CDI_PM    0x10
+
+// Mux channel for displays not behind a multiplexer
+#define CD_NO_MUX 0xff
+
+// Fields for software dimming (setFieldLevel)
+#define CDF_MONTH 0
+#define CDF_DAY   1
+#define CDF_YEAR  2
+#define CDF_HOUR  3
+#define CDF_MIN   4
+#define CDF_NUM   5
+#define CDF_ALL   ((1 << CDF_NUM) - 1)
+
 class clockDisplay {
 
+    #ifdef TC_BENCH
+    friend void bench_run();
+    #endif
+
     public:
 
-        clockDisplay(uint8_t did, uint8_t address);
+        clockDisplay(uint8_t did, uint8_t address, uint8_t mux = CD_NO_MUX, TwoWire *bus = &Wire);
         void begin();
         void on();
         void onCond();
@@ -56,7 +88,13 @@ class clockDisplay {
         void setRTC(bool rtc);  // make this an RTC display
         bool isRTC();
 
+        uint32_t getI2CErrors();
+        static uint32_t getMuxSwitches();
+        uint32_t getBusBytes();
+        uint32_t getBusTransactions();
+
         void show();
+        void showChanged();
         void showAnimate1();
         void showAnimate2();
 
@@ -92,8 +130,19 @@ class clockDisplay {
 
         void showTextDirect(const char *text, uint16_t flags = CDT_CLEAR);
 
+        void getImage(clockImage *img);
+        void setImage(const clockImage *img);
+
+        void setRaw(const uint8_t *src);
+
+        #ifdef TC_SOFTDIM
+        void setFieldLevel(int field, uint8_t level);
+        bool setDimStep(uint8_t step);
+        #endif
+
         bool colonBlink = false;
         bool isOn = false;
+        bool rawMode = false;           // Buffer is shown as set by setRaw()
 
     private:
 
@@ -102,11 +151,14 @@ class clockDisplay {
         uint16_t getLEDAlphaChar(uint8_t value);
         
         uint16_t makeNum(uint8_t num, uint16_t dflags = 0);
+        int      makeText(const char *text, uint16_t *buf, uint16_t flags);
 
         void directCol(int col, int segments);
 
         void clearDisplay();
         void showInt(bool animate = false, bool Alt = false);
+        uint16_t dimWord(int col);
+        void setFlagsInBuf();
 
         void colonOn();
         void colonOff();
@@ -120,11 +172,18 @@ class clockDisplay {
         void directAMPMoff();
 
         void directCmd(uint8_t val);
+        void beginTransmission();
+        void write(uint8_t val);
+        uint8_t endTransmission();
 
         uint8_t  _did = 0;
         uint8_t  _address = 0;
+        uint8_t  _mux = CD_NO_MUX;
+        TwoWire  *_bus = &Wire;
         uint16_t _displayBuffer[CD_BUF_SIZE];
         uint16_t _displayBufferAlt[CD_BUF_SIZE];
+        uint16_t _shadowBuffer[CD_BUF_SIZE];    // What was last written to display RAM
+        bool     _shadowValid = false;
 
         uint16_t _year = 2021;          // keep track of these
         int16_t  _yearoffset = 0;       // Offset for faking years < 2000, > 2098
@@ -154,6 +213,16 @@ class clockDisplay {
         char    _CacheData[10];
 
         int     _savePending = 0;
+
+        uint32_t _i2cErrors = 0;
+        uint32_t _busBytes = 0;
+        uint32_t _busTransactions = 0;
+        uint32_t _txStart = 0;              // _busBytes at start of transaction
+
+        #ifdef TC_SOFTDIM
+        uint8_t  _fieldLevel[CDF_NUM] = { 255, 255, 255, 255, 255 };
+        uint8_t  _fieldsVisible = CDF_ALL;  // Fields not blanked in current PWM step
+        #endif
 };
 
 #endif
@@ -11,6 +11,7 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include "rtc.h"
+#include "tc_trace.h"
 
 // Registers
 #define DS3231_TIME       0x00 // Time 
@@ -154,6 +155,7 @@ void tcRTC::now(DateTime& dt)
                bcd2bin(buffer[2]),
                bcd2bin(buffer[1]),
                bcd2bin(buffer[0] & 0x7F));
+        break;
 
     case RTCT_DS3231:
     default:
@@ -283,6 +285,22 @@ float tcRTC::getTemperature()
     return 0.0f;
 }
 
+uint32_t tcRTC::getI2CErrors()
+{
+    return _i2cErrors;
+}
+
+// Bus traffic: Bytes (including address bytes) and transactions
+uint32_t tcRTC::getBusBytes()
+{
+    return _busBytes;
+}
+
+uint32_t tcRTC::getBusTransactions()
+{
+    return _busTransactions;
+}
+
 /*
  * Write value to register
  */
@@ -308,15 +326,25 @@ void tcRTC::write_bytes(uint8_t *buffer, uint8_t num)
     for(int i = 0; i < num; i++) {
         Wire.write(buffer[i]);
     }
-    Wire.endTransmission();   
+    TRACE_BEGIN(TR_I2C, _address);
+    if(Wire.endTransmission()) _i2cErrors++;
+    TRACE_END(TR_I2C, TR_I2C_ARG(_address, 0, num, 0));
+
+    _busBytes += 1 + num;
+    _busTransactions++;
 }
 
 void tcRTC::read_bytes(uint8_t reg, uint8_t *buffer, uint8_t num)
 {
     Wire.beginTransmission(_address);
     Wire.write(reg);
-    Wire.endTransmission();
-    Wire.requestFrom(_address, num);
+    TRACE_BEGIN(TR_I2C, _address);
+    if(Wire.endTransmission()) _i2cErrors++;
+    if(Wire.requestFrom(_address, num) != num) _i2cErrors++;
+    TRACE_END(TR_I2C, TR_I2C_ARG(_address, 0, num, 1));
+
+    _busBytes += 2 + 1 + num;
+    _busTransactions += 2;
     for(int i = 0; i < num; i++) {
         buffer[i] = Wire.read();
     }
@@ -102,6 +102,10 @@ class tcRTC
 
         float getTemperature();
 
+        uint32_t getI2CErrors();
+        uint32_t getBusBytes();
+        uint32_t getBusTransactions();
+
     private:
 
         static uint8_t dowToDS3231(uint8_t d) { return d == 0 ? 7 : d; }
@@ -117,6 +121,10 @@ class tcRTC
         uint8_t _addrArr[2*2];
         uint8_t _address;
         uint8_t _rtcType = RTCT_DS3231;
+
+        uint32_t _i2cErrors = 0;
+        uint32_t _busBytes = 0;
+        uint32_t _busTransactions = 0;
 };
 
 #endif
@@ -23,12 +23,10 @@
 
 #ifdef TC_HAVESPEEDO
 
-#define SP_NUM_TYPES    12  // Number of speedo display types supported
-#define SP_MIN_TYPE     0
-
 #include <Arduino.h>
 #include <math.h>
 #include "speeddisplay.h"
+#include "tc_trace.h"
 #include <Wire.h>
 
 // The segments' wiring to buffer bits
@@ -99,7 +97,7 @@
 #define S14GR4_BV  0x0800     // bottom vertical
 #define S14GR4_DOT 0x0000     // dot (has none)
 
-static const uint16_t font7segGeneric[38] = {
+static constexpr uint16_t font7segGeneric[38] = {
     S7G_T|S7G_TR|S7G_BR|S7G_B|S7G_BL|S7G_TL,
     S7G_TR|S7G_BR,
     S7G_T|S7G_TR|S7G_B|S7G_BL|S7G_M,
@@ -140,7 +138,7 @@ static const uint16_t font7segGeneric[38] = {
     S7G_M
 };
 
-static const uint16_t font14segGeneric[38] = {
+static constexpr uint16_t font14segGeneric[38] = {
     S14_T|S14_TL|S14_TR|S14_B|S14_BL|S14_BR,
     S14_TR|S14_BR,
     S14_T|S14_TR|S14_ML|S14_MR|S14_B|S14_BL,
@@ -181,7 +179,7 @@ static const uint16_t font14segGeneric[38] = {
     S14_ML|S14_MR
 };
 
-static const uint16_t font14segGrove[38] = {
+static constexpr uint16_t font14segGrove[38] = {
     S14GR_T|S14GR_TL|S14GR_TR|S14GR_B|S14GR_BL|S14GR_BR,
     S14GR_TR|S14GR_BR,
     S14GR_T|S14GR_TR|S14GR_ML|S14GR_MR|S14GR_B|S14GR_BL,
@@ -222,7 +220,7 @@ static const uint16_t font14segGrove[38] = {
     S14GR_ML|S14GR_MR
 };
 
-static const uint16_t font144segGrove[38] = {
+static constexpr uint16_t font144segGrove[38] = {
     S14GR4_T|S14GR4_TL|S14GR4_TR|S14GR4_B|S14GR4_BL|S14GR4_BR,
     S14GR4_TR|S14GR4_BR,
     S14GR4_T|S14GR4_TR|S14GR4_ML|S14GR4_MR|S14GR4_B|S14GR4_BL,
@@ -263,7 +261,10 @@ static const uint16_t font144segGrove[38] = {
     S14GR4_ML|S14GR4_MR
 };
 
-static const struct dispConf {
+// The layouts are constexpr, so that the template functions below are
+// specialized at compile time for TC_SPEEDO_TYPE. Unused layouts and fonts
+// are not referenced, and drop out of the binary.
+static constexpr struct dispConf {
     bool     is7seg;         //   7- or 14-segment-display?
     uint8_t  speed_pos10;    //   Speed's 10s position in 16bit buffer
     uint8_t  speed_pos01;    //   Speed's 1s position in 16bit buffer
@@ -293,6 +294,8 @@ static const struct dispConf {
   { true,  0, 1, 0, 0, 1, 0, 255,      0, 2, 0, { 0, 1 },       { 0, 0, 0, 0 }, font7segGeneric },  // like SP_ADAF_7x4L(ADA-878), but left tube only (TW speedo replica) - needs rewiring
 };
 
+static_assert(TC_SPEEDO_TYPE >= SP_MIN_TYPE && TC_SPEEDO_TYPE < SP_NUM_TYPES, "Bad TC_SPEEDO_TYPE");
+
 // Grove 4-digit special handling
 static const uint16_t gr4_sh1[4] = { 1<<4, 1<<6,  1<<5, 1<<10 };
 static const uint16_t gr4_sh2[4] = { 1<<3, 1<<14, 1<<9, 1<<8  };
@@ -301,44 +304,173 @@ static const uint16_t gr4_sh2[4] = { 1<<3, 1<<14, 1<<9, 1<<8  };
 // Pos 2: 0x02 - center colon (both dots),  0x04 - left colon - lower dot
 //        0x08 - left colon - upper dot,    0x10 - decimal point (upper right)
 
-// Store i2c address
-speedDisplay::speedDisplay(uint8_t address)
+/*
+ * Layout specific rendering
+ *
+ * T is the display type; everything depending on the layout is
+ * resolved at compile time.
+ */
+
+// Buffer position of digit i (left to right)
+template<int T> static inline uint8_t spBufPos(int i)
 {
-    _address = address;
+    return (i == 0) ? displays[T].bufPosArr[0] :
+           (i == 1) ? displays[T].bufPosArr[1] :
+           (i == 2) ? displays[T].bufPosArr[2] :
+                      displays[T].bufPosArr[3];
 }
 
-// Start the display
-bool speedDisplay::begin(int dispType)
+// Shift value for digit i (left to right)
+template<int T> static inline uint8_t spBufShft(int i)
+{
+    return (i == 0) ? displays[T].bufShftArr[0] :
+           (i == 1) ? displays[T].bufShftArr[1] :
+           (i == 2) ? displays[T].bufShftArr[2] :
+                      displays[T].bufShftArr[3];
+}
+
+// Returns bit pattern for provided character
+template<int T> static uint16_t spGetLEDChar(uint8_t value)
+{
+    if(value >= '0' && value <= '9') {
+        return displays[T].fontSeg[value - '0'];
+    } else if(value >= 'A' && value <= 'Z') {
+        return displays[T].fontSeg[value - 'A' + 10];
+    } else if(value >= 'a' && value <= 'z') {
+        return displays[T].fontSeg[value - 'a' + 10];
+    } else if(value == '.') {
+        return displays[T].fontSeg[36];
+    } else if(value == '-')
+        return displays[T].fontSeg[37];
+
+    return 0;
+}
+
+template<int T> static void spHandleColon(uint16_t *buf, bool colon)
+{
+    if(displays[T].colon_pos < 255) {
+        if(colon) buf[displays[T].colon_pos] |= displays[T].colon_bit;
+        else      buf[displays[T].colon_pos] &= (~displays[T].colon_bit);
+    }
+}
+
+template<int T> static void spSetText(uint16_t *buf, const char *text, bool colon)
+{
+    int idx = 0, pos = 0, dgt = 0;
+    int temp = 0;
+
+    for(int i = 0; i < 8; i++) {
+        buf[i] = 0;
+    }
+
+    if(displays[T].is7seg) {
+        while(text[idx] && (pos < (displays[T].num_digs / (1<<displays[T].buf_packed)))) {
+            temp = spGetLEDChar<T>(text[idx]) << spBufShft<T>(dgt);
+            idx++;
+            if(text[idx] == '.') {
+                temp |= (spGetLEDChar<T>('.') << spBufShft<T>(dgt));
+                idx++;
+            }
+            dgt++;
+            if(displays[T].buf_packed && text[idx]) {
+                temp |= (spGetLEDChar<T>(text[idx]) << spBufShft<T>(dgt));
+                idx++;
+                if(text[idx] == '.') {
+                    temp |= (spGetLEDChar<T>('.') << spBufShft<T>(dgt));
+                    idx++;
+                }
+                dgt++;
+            }
+            buf[spBufPos<T>(pos)] = temp;
+            pos++;
+        }
+    } else {
+        while(text[idx] && pos < displays[T].num_digs) {
+            buf[spBufPos<T>(pos)] = spGetLEDChar<T>(text[idx]);
+            idx++;
+            if(text[idx] == '.') {
+                buf[spBufPos<T>(pos)] |= spGetLEDChar<T>('.');
+                idx++;
+            }
+            pos++;
+        }
+    }
+
+    spHandleColon<T>(buf, colon);
+}
+
+template<int T> static void spSetSpeed(uint16_t *buf, int8_t speedNum, bool dot01)
 {
-    if(dispType < SP_MIN_TYPE || dispType >= SP_NUM_TYPES) {
-        #ifdef TC_DBG
-        Serial.printf("Bad speedo display type: %d\n", dispType);
+    uint16_t b1, b2;
+
+    for(int i = 0; i < 8; i++) {
+        buf[i] = 0;
+    }
+
+    if(speedNum < 0) {
+        b1 = b2 = displays[T].fontSeg[37];
+    } else if(speedNum > 99) {
+        b1 = displays[T].fontSeg['H' - 'A' + 10];
+        b2 = displays[T].fontSeg['I' - 'A' + 10];
+    } else {
+        b1 = displays[T].fontSeg[speedNum / 10];
+        b2 = displays[T].fontSeg[speedNum % 10];
+        #ifdef SP_CS_0ON
+        if(T == SP_CIRCSETUP) {
+            // Hack to display "0" after dot
+            buf[2] = 0b00111111;
+        }
         #endif
-        dispType = SP_MIN_TYPE;
     }
 
+    buf[displays[T].speed_pos10] |= (b1 << displays[T].dig10_shift);
+    buf[displays[T].speed_pos01] |= (b2 << displays[T].dig01_shift);
+
+    if(dot01) buf[displays[T].dot_pos01] |= (displays[T].fontSeg[36] << displays[T].dot01_shift);
+}
+
+// Type specific buffer fixups before writing to the display
+template<int T> static void spFixup(uint16_t *buf)
+{
+    if(T == SP_ADAF_B7x4 || T == SP_ADAF_B7x4L) {
+        buf[displays[T].colon_pos] &= ~(0x10);
+        if(buf[spBufPos<T>(2)] & S7G_DOT) {
+            buf[displays[T].colon_pos] |= 0x10;
+        }
+    } else if(T == SP_GROVE_4DIG14 || T == SP_GROVE_4DIG14L) {
+        buf[displays[T].colon_pos] &= ~(0x4778);
+        for(int i = 0; i < 4; i++) {
+            buf[displays[T].colon_pos] |= ((buf[spBufPos<T>(i)] & 0x02) ? gr4_sh1[i] : 0);
+            buf[displays[T].colon_pos] |= ((buf[spBufPos<T>(i)] & 0x04) ? gr4_sh2[i] : 0);
+        }
+    }
+}
+
+#ifdef TC_BENCH
+// Instances for all types, for benchmarking
+#define SP_BENCH(t) { spSetSpeed<t>, spSetText<t> }
+const spBenchFuncs speedo_bench_funcs[SP_NUM_TYPES] = {
+    SP_BENCH(0), SP_BENCH(1), SP_BENCH(2),  SP_BENCH(3),
+    SP_BENCH(4), SP_BENCH(5), SP_BENCH(6),  SP_BENCH(7),
+    SP_BENCH(8), SP_BENCH(9), SP_BENCH(10), SP_BENCH(11)
+};
+#endif
+
+// Store i2c address and bus
+speedDisplay::speedDisplay(uint8_t address, TwoWire *bus)
+{
+    _address = address;
+    _bus = bus;
+}
+
+// Start the display
+bool speedDisplay::begin()
+{
     // Check for speedo on i2c bus
-    Wire.beginTransmission(_address);
-    if(Wire.endTransmission(true))
+    _bus->beginTransmission(_address);
+    if(_bus->endTransmission(true))
         return false;
 
-    _dispType = dispType;
-    _is7seg = displays[dispType].is7seg;
-    _speed_pos10 = displays[dispType].speed_pos10;
-    _speed_pos01 = displays[dispType].speed_pos01;
-    _dig10_shift = displays[dispType].dig10_shift;
-    _dig01_shift = displays[dispType].dig01_shift;
-    _dot_pos01 = displays[dispType].dot_pos01;
-    _dot01_shift = displays[dispType].dot01_shift;
-    _colon_pos = displays[dispType].colon_pos;
-    _colon_bm = displays[dispType].colon_bit;
-    _num_digs = displays[dispType].num_digs;
-    _buf_packed = displays[dispType].buf_packed;
-    _bufPosArr = displays[dispType].bufPosArr;
-    _bufShftArr = displays[dispType].bufShftArr;
-    
-    _fontXSeg = displays[dispType].fontSeg;
-
     directCmd(0x20 | 1); // turn on oscillator
 
     clearBuf();          // clear buffer
@@ -441,37 +573,37 @@ void speedDisplay::show()
         }
     }
 
-    switch(_dispType) {
-    case SP_ADAF_B7x4:
-    case SP_ADAF_B7x4L:
-        _displayBuffer[_colon_pos] &= ~(0x10);
-        if(_displayBuffer[*(_bufPosArr + 2)] & S7G_DOT) {
-            _displayBuffer[_colon_pos] |= 0x10;
-        }
-        break;
-    case SP_GROVE_4DIG14:
-    case SP_GROVE_4DIG14L:
-        _displayBuffer[_colon_pos] &= ~(0x4778);
-        for(int i = 0; i < 4; i++) {
-            _displayBuffer[_colon_pos] |= ((_displayBuffer[*(_bufPosArr + i)] & 0x02) ? gr4_sh1[i] : 0);
-            _displayBuffer[_colon_pos] |= ((_displayBuffer[*(_bufPosArr + i)] & 0x04) ? gr4_sh2[i] : 0);
-        }
-    }
+    spFixup<TC_SPEEDO_TYPE>(_displayBuffer);
 
-    Wire.beginTransmission(_address);
-    Wire.write(0x00);  // start address
+    beginTransmission();
+    write(0x00);  // start address
 
     for(i = 0; i < 8; i++) {
-        Wire.write(_displayBuffer[i] & 0xFF);
-        Wire.write(_displayBuffer[i] >> 8);
+        write(_displayBuffer[i] & 0xFF);
+        write(_displayBuffer[i] >> 8);
     }
 
-    Wire.endTransmission();
+    endTransmission();
 
-    // Save last value written to _colon_pos
-    if(_colon_pos < 255) {
-        _lastBufPosCol = _displayBuffer[_colon_pos];
+    // Save last value written to colon position
+    if(displays[TC_SPEEDO_TYPE].colon_pos < 255) {
+        _lastBufPosCol = _displayBuffer[displays[TC_SPEEDO_TYPE].colon_pos];
+    }
+}
+
+
+// Show the buffer as set by setRaw(), without type specific fixups
+void speedDisplay::showRaw()
+{
+    beginTransmission();
+    write(0x00);  // start address
+
+    for(int i = 0; i < 8; i++) {
+        write(_displayBuffer[i] & 0xFF);
+        write(_displayBuffer[i] >> 8);
     }
+
+    endTransmission();
 }
 
 
@@ -484,77 +616,16 @@ void speedDisplay::show()
 // ignored.)
 void speedDisplay::setText(const char *text)
 {
-    int idx = 0, pos = 0, dgt = 0;
-    int temp = 0;
-
-    clearBuf();
-
-    if(_is7seg) {
-        while(text[idx] && (pos < (_num_digs / (1<<_buf_packed)))) {
-            temp = getLEDChar(text[idx]) << (*(_bufShftArr + dgt));
-            idx++;
-            if(text[idx] == '.') {
-                temp |= (getLEDChar('.') << (*(_bufShftArr + dgt)));
-                idx++;
-            }
-            dgt++;
-            if(_buf_packed && text[idx]) {
-                temp |= (getLEDChar(text[idx]) << (*(_bufShftArr + dgt)));
-                idx++;
-                if(text[idx] == '.') {
-                    temp |= (getLEDChar('.') << (*(_bufShftArr + dgt)));
-                    idx++;
-                }
-                dgt++;
-            }
-            _displayBuffer[*(_bufPosArr + pos)] = temp;
-            pos++;
-        }
-    } else {
-        while(text[idx] && pos < _num_digs) {
-            _displayBuffer[*(_bufPosArr + pos)] = getLEDChar(text[idx]);
-            idx++;
-            if(text[idx] == '.') {
-                _displayBuffer[*(_bufPosArr + pos)] |= getLEDChar('.');
-                idx++;
-            }
-            pos++;
-        }
-    }
-
-    handleColon();
+    spSetText<TC_SPEEDO_TYPE>(_displayBuffer, text, _colon);
 }
 
 // Write given speed to buffer
 // (including current dot01 setting; colon is cleared and ignored)
 void speedDisplay::setSpeed(int8_t speedNum)
 {
-    uint16_t b1, b2;
-    
-    clearBuf();
-
     _speed = speedNum;
 
-    if(speedNum < 0) {
-        b1 = b2 = *(_fontXSeg + 37);
-    } else if(speedNum > 99) {
-        b1 = *(_fontXSeg + ('H' - 'A' + 10));
-        b2 = *(_fontXSeg + ('I' - 'A' + 10));
-    } else {
-        b1 = *(_fontXSeg + (speedNum / 10));
-        b2 = *(_fontXSeg + (speedNum % 10));
-        #ifdef SP_CS_0ON
-        if(_dispType == SP_CIRCSETUP) {
-            // Hack to display "0" after dot
-            _displayBuffer[2] = 0b00111111;
-        }
-        #endif
-    }
-
-    _displayBuffer[_speed_pos10] |= (b1 << _dig10_shift);
-    _displayBuffer[_speed_pos01] |= (b2 << _dig01_shift);
-    
-    if(_dot01) _displayBuffer[_dot_pos01] |= (*(_fontXSeg + 36) << _dot01_shift);
+    spSetSpeed<TC_SPEEDO_TYPE>(_displayBuffer, speedNum, _dot01);
 }
 
 // Set/clear dot at speed's 1's position.
@@ -569,6 +640,15 @@ void speedDisplay::setColon(bool colon)
     _colon = colon;
 }
 
+// Set the buffer from raw display RAM contents (two bytes per
+// column, low byte first)
+void speedDisplay::setRaw(const uint8_t *src)
+{
+    for(int i = 0; i < 8; i++) {
+        _displayBuffer[i] = src[i * 2] | (src[i * 2 + 1] << 8);
+    }
+}
+
 
 // Query data ------------------------------------------------------------------
 
@@ -589,54 +669,94 @@ bool speedDisplay::getColon()
     return _colon;
 }
 
-// Private functions ###########################################################
+uint32_t speedDisplay::getI2CErrors()
+{
+    return _i2cErrors;
+}
 
+// Bus traffic: Bytes (including address bytes) and transactions
+uint32_t speedDisplay::getBusBytes()
+{
+    return _busBytes;
+}
 
-void speedDisplay::handleColon()
+uint32_t speedDisplay::getBusTransactions()
 {
-    if(_colon_pos < 255) {
-        if(_colon) _displayBuffer[_colon_pos] |= _colon_bm;
-        else       _displayBuffer[_colon_pos] &= (~_colon_bm);
-    }
+    return _busTransactions;
 }
 
-// Returns bit pattern for provided character
-uint16_t speedDisplay::getLEDChar(uint8_t value)
+// Copy the rendered state to an image
+void speedDisplay::getImage(speedImage *img)
 {
-    if(value >= '0' && value <= '9') {
-        return *(_fontXSeg + (value - '0'));
-    } else if(value >= 'A' && value <= 'Z') {
-        return *(_fontXSeg + (value - 'A' + 10));
-    } else if(value >= 'a' && value <= 'z') {
-        return *(_fontXSeg + (value - 'a' + 10));
-    } else if(value == '.') {
-        return *(_fontXSeg + 36);
-    } else if(value == '-')
-        return *(_fontXSeg + 37);
+    memcpy(img->buf, _displayBuffer, sizeof(img->buf));
+    img->brightness = _brightness;
+    img->on = (_onCache > 0);
+}
 
-    return 0;
+// Restore and show the rendered state from an image
+void speedDisplay::setImage(const speedImage *img)
+{
+    if(img->on) {
+        memcpy(_displayBuffer, img->buf, sizeof(_displayBuffer));
+        show();
+        setBrightness(img->brightness);
+        on();
+    } else {
+        off();
+    }
 }
 
+// Private functions ###########################################################
+
+
 // Directly clear the display
 void speedDisplay::clearDisplay()
 {
-    Wire.beginTransmission(_address);
-    Wire.write(0x00);  // start address
+    beginTransmission();
+    write(0x00);  // start address
 
     for(int i = 0; i < 8*2; i++) {
-        Wire.write(0x0);
+        write(0x0);
     }
 
-    Wire.endTransmission();
+    endTransmission();
 
     _lastBufPosCol = 0;
 }
 
 void speedDisplay::directCmd(uint8_t val)
 {
-    Wire.beginTransmission(_address);
-    Wire.write(val);
-    Wire.endTransmission();
+    beginTransmission();
+    write(val);
+    endTransmission();
+}
+
+void speedDisplay::beginTransmission()
+{
+    _bus->beginTransmission(_address);
+    _txStart = _busBytes;
+}
+
+void speedDisplay::write(uint8_t val)
+{
+    _bus->write(val);
+    _busBytes++;
+}
+
+uint8_t speedDisplay::endTransmission()
+{
+    uint8_t ret;
+
+    TRACE_BEGIN(TR_I2C, _address);
+    ret = _bus->endTransmission();
+    TRACE_END(TR_I2C, TR_I2C_ARG(_address, (_bus == &Wire) ? 0 : 1, _busBytes - _txStart, 0));
+
+    _busBytes++;            // Address
+    _busTransactions++;
+
+    if(ret) _i2cErrors++;
+
+    return ret;
 }
 
 #endif
@@ -22,6 +22,8 @@
 #ifndef _speedDisplay_H
 #define _speedDisplay_H
 
+#include <Wire.h>
+
 // The supported display types:
 // The speedo is a 2-digit 7-segment display, with the bottom/right dot lit
 // in the movies.
@@ -54,13 +56,33 @@ enum dispTypes : uint8_t {
 };
 
 // If new displays are added, SP_NUM_TYPES needs to be adapted.
+#define SP_NUM_TYPES    12  // Number of speedo display types supported
+#define SP_MIN_TYPE     0
+
+// The display type is selected at compile time through TC_SPEEDO_TYPE
+// (in tc_global.h).
+
+// Rendered state of the speedo (scenes)
+struct speedImage {
+    uint16_t buf[8];
+    uint8_t  brightness;
+    uint8_t  on;
+};
+
+#ifdef TC_BENCH
+struct spBenchFuncs {
+    void (*setSpeed)(uint16_t *buf, int8_t speedNum, bool dot01);
+    void (*setText)(uint16_t *buf, const char *text, bool colon);
+};
+extern const spBenchFuncs speedo_bench_funcs[SP_NUM_TYPES];
+#endif
 
 class speedDisplay {
 
     public:
 
-        speedDisplay(uint8_t address);
-        bool begin(int dispType);
+        speedDisplay(uint8_t address, TwoWire *bus = &Wire);
+        bool begin();
         void on();
         void off();
 
@@ -74,25 +96,35 @@ class speedDisplay {
         bool getNightMode();
 
         void show();
+        void showRaw();
 
         void setText(const char *text);
         void setSpeed(int8_t speedNum);
         void setDot(bool dot01 = true);
         void setColon(bool colon);
+        void setRaw(const uint8_t *src);
 
         uint8_t getSpeed();
         bool getDot();
         bool getColon();
 
-    private:
+        uint32_t getI2CErrors();
+        uint32_t getBusBytes();
+        uint32_t getBusTransactions();
+
+        void getImage(speedImage *img);
+        void setImage(const speedImage *img);
 
-        void handleColon();
-        uint16_t getLEDChar(uint8_t value);
+    private:
 
         void clearDisplay();                    // clears display RAM
         void directCmd(uint8_t val);
+        void beginTransmission();
+        void write(uint8_t val);
+        uint8_t endTransmission();
 
         uint8_t _address;
+        TwoWire *_bus;
         uint16_t _displayBuffer[8];
 
         int8_t _onCache = -1;                   // Cache for on/off
@@ -108,24 +140,12 @@ class speedDisplay {
         bool    _nightmode = false;
         int     _oldnm = -1;
 
-        uint8_t  _dispType;
-        bool     _is7seg;           //      7- or 14-segment-display?
-        uint8_t  _speed_pos10;      //      Speed's 10s position in 16bit buffer
-        uint8_t  _speed_pos01;      //      Speed's 1s position in 16bit buffer
-        uint8_t  _dig10_shift;      //      Shift 10s to align in buffer
-        uint8_t  _dig01_shift;      //      Shift 1s to align in buffer
-        uint8_t  _dot_pos01;        //      1s dot position in 16bit buffer
-        uint8_t  _dot01_shift;      //      1s dot shift to align in buffer
-        uint8_t  _colon_pos;        //      Pos of colon in 16bit buffer (255 = no colon)
-        uint16_t _colon_bm;         //      bitmask for colon
-        uint8_t  _num_digs;         //      total number of digits/letters (max 4)
-        uint8_t  _buf_packed;       //      2 digits in one buffer pos? (0=no, 1=yes)
-        const uint8_t *_bufPosArr;  //      Array of buffer positions for digits left->right
-        const uint8_t *_bufShftArr; //      Array of shift values for each digit
-
-        const uint16_t *_fontXSeg;
-
         uint16_t _lastBufPosCol;
+
+        uint32_t _i2cErrors = 0;
+        uint32_t _busBytes = 0;
+        uint32_t _busTransactions = 0;
+        uint32_t _txStart = 0;                  // _busBytes at start of transaction
 };
 
 #endif
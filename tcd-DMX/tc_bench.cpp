@@ -0,0 +1,396 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Micro benchmarks
+ *
+ * Times the per-frame hot paths (channel decoding, user personality
+ * interpreter, number/text rendering, speedo layout) against synthetic
+ * DMX frame streams,
+ * without any bus access. Results are printed as CSV lines:
+ *
+ * bench,<name>,<input>,<ops>,<ns/op>,<cycles/op>
+ *
+ * Build with TC_BENCH defined; the benchmarks run once at boot.
+ * bench_bus() times display updates on the I2C bus; it runs once
+ * the displays are set up. With TC_SOFTDIM, it also times software
+ * dimming's worst-case PWM step at each bus clock.
+ *
+ * tools/bench.cpp runs the same benchmarks on the host, against the
+ * emulated bus, and writes the CSV lines to stdout.
+ * -------------------------------------------------------------------
+ */
+
+#include "tc_global.h"
+
+#ifdef TC_BENCH
+
+#include <Arduino.h>
+
+#include "tc_bench.h"
+#include "clockdisplay.h"
+#include "speeddisplay.h"
+#include "tc_userpers.h"
+#include "tc_dmx.h"
+
+#define BENCH_FRAMES    256     // Frames per input stream
+#define BENCH_SLOTS      11     // Channels per display
+#define BENCH_REPEAT     16     // Passes over each stream
+#define BENCH_BUS_REPEAT 32     // Passes over all displays (bus)
+
+#ifdef TC_SOFTDIM
+static const uint32_t dimClocks[] = { 100000, 400000 };
+#endif
+
+enum {
+    BI_FADE = 0,
+    BI_CUEJUMP,
+    BI_NOISE,
+    BI_NUM
+};
+
+static const char *inputNames[BI_NUM] = {
+    "fade", "cuejump", "noise"
+};
+
+static uint8_t frames[BENCH_FRAMES][BENCH_SLOTS];
+
+static uint32_t benchSeed = 0x1986;
+
+// Result sink to keep the compiler from dropping the work
+static volatile uint32_t benchSink;
+
+void dmx_bench_decode(clockDisplay *display, const uint8_t *src, int pers);
+
+static uint8_t benchRand()
+{
+    benchSeed = benchSeed * 1664525 + 1013904223;
+    return benchSeed >> 24;
+}
+
+/*
+ * Generate input streams
+ */
+static void genFrames(int type)
+{
+    static const uint8_t cues[4][BENCH_SLOTS] = {
+        {  96,  40,  20, 236, 138,  61, 200,  50, 200, 128, 255 },
+        { 224, 208,  20, 236, 159, 138,  20, 100,  50, 200, 255 },
+        { 128, 208,  20, 236, 159, 138,  20, 100,  50,  40, 128 },
+        {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 }
+    };
+
+    for(int i = 0; i < BENCH_FRAMES; i++) {
+        switch(type) {
+        case BI_FADE:
+            // All channels fade slowly, like a crossfade on a console
+            for(int j = 0; j < BENCH_SLOTS; j++) {
+                frames[i][j] = (i + j * 16) & 0xff;
+            }
+            break;
+        case BI_CUEJUMP:
+            // Static frames, jumping to another cue every 32 frames
+            memcpy(frames[i], cues[(i / 32) & 3], BENCH_SLOTS);
+            break;
+        default:
+            for(int j = 0; j < BENCH_SLOTS; j++) {
+                frames[i][j] = benchRand();
+            }
+        }
+    }
+}
+
+// Full frame through the built-in decoder
+static void decodeBuiltin(const uint8_t *src, uint8_t *out)
+{
+    for(int d = 0; d < PERS_NUM_DISPLAYS; d++) {
+        persDecode(src + d * PERS_DISPLAY_SLOTS, out + d * UP_FIELDS);
+        out[d * UP_FIELDS + PF_MODE] = persDecodeGlobal<PG_MODE>(src[PERS_GLOBAL_SLOT(PG_MODE, d)]);
+        out[d * UP_FIELDS + PF_RATE] = src[PERS_GLOBAL_SLOT(PG_RATE, d)];
+    }
+}
+
+static void printResult(const char *name, const char *input, uint32_t ops, uint32_t cycles)
+{
+    uint32_t mhz = ESP.getCpuFreqMHz();
+
+    Serial.printf("bench,%s,%s,%lu,%lu,%lu\n", name, input,
+        (unsigned long)ops,
+        (unsigned long)((uint64_t)cycles * 1000 / mhz / ops),
+        (unsigned long)(cycles / ops));
+}
+
+void bench_run()
+{
+    clockDisplay  disp(DISP_DEST, 0x71);
+    uint16_t buf[CD_BUF_SIZE];
+    char     text[DISP_LEN + 1];
+    uint32_t start, cycles, ops;
+
+    disp.clearBuf();
+
+    Serial.printf("bench,version,%s,%s,%lu\n", TC_VERSION, TC_VERSION_EXTRA,
+        (unsigned long)ESP.getCpuFreqMHz());
+
+    for(int input = 0; input < BI_NUM; input++) {
+
+        genFrames(input);
+
+        // Channel decoding (DMX mode)
+        ops = BENCH_FRAMES * BENCH_REPEAT;
+        start = ESP.getCycleCount();
+        for(int r = 0; r < BENCH_REPEAT; r++) {
+            for(int i = 0; i < BENCH_FRAMES; i++) {
+                dmx_bench_decode(&disp, frames[i], PERS_STANDARD);
+            }
+        }
+        cycles = ESP.getCycleCount() - start;
+        benchSink = disp._displayBuffer[0];
+        printResult("decode", inputNames[input], ops, cycles);
+
+        // Same, 16-bit personality
+        start = ESP.getCycleCount();
+        for(int r = 0; r < BENCH_REPEAT; r++) {
+            for(int i = 0; i < BENCH_FRAMES; i++) {
+                dmx_bench_decode(&disp, frames[i], PERS_16BIT);
+            }
+        }
+        cycles = ESP.getCycleCount() - start;
+        benchSink = disp._displayBuffer[0];
+        printResult("decode16", inputNames[input], ops, cycles);
+
+        // Full frame: Built-in decoder vs. user personality interpreter
+        // running a program compiled from the built-in layout. Frames
+        // are taken from the stream at display-sized offsets.
+        if(userpers_bench_builtin()) {
+            const uint8_t *flat = &frames[0][0];
+            uint8_t val1[PERS_NUM_DISPLAYS * UP_FIELDS], val2[PERS_NUM_DISPLAYS * UP_FIELDS];
+            int nf = (BENCH_FRAMES * BENCH_SLOTS - PERS_FOOTPRINT) / BENCH_SLOTS;
+            int bad = 0;
+
+            for(int i = 0; i < nf; i++) {
+                decodeBuiltin(flat + i * BENCH_SLOTS, val1);
+                userpers_run(flat + i * BENCH_SLOTS, val2);
+                if(memcmp(val1, val2, sizeof(val1))) bad++;
+            }
+            if(bad) {
+                Serial.printf("bench,userpers-mismatch,%s,%d\n", inputNames[input], bad);
+            }
+
+            ops = nf * BENCH_REPEAT;
+            start = ESP.getCycleCount();
+            for(int r = 0; r < BENCH_REPEAT; r++) {
+                for(int i = 0; i < nf; i++) {
+                    decodeBuiltin(flat + i * BENCH_SLOTS, val1);
+                    benchSink += val1[PF_MONTH];
+                }
+            }
+            cycles = ESP.getCycleCount() - start;
+            printResult("frame-builtin", inputNames[input], ops, cycles);
+
+            start = ESP.getCycleCount();
+            for(int r = 0; r < BENCH_REPEAT; r++) {
+                for(int i = 0; i < nf; i++) {
+                    userpers_run(flat + i * BENCH_SLOTS, val2);
+                    benchSink += val2[PF_MONTH];
+                }
+            }
+            cycles = ESP.getCycleCount() - start;
+            printResult("frame-userpers", inputNames[input], ops, cycles);
+        }
+
+        // Number rendering
+        ops = BENCH_FRAMES * BENCH_REPEAT;
+        start = ESP.getCycleCount();
+        for(int r = 0; r < BENCH_REPEAT; r++) {
+            for(int i = 0; i < BENCH_FRAMES; i++) {
+                benchSink += disp.makeNum(frames[i][0] % 100, (frames[i][1] & 1) ? CDD_FORCE24 : 0);
+            }
+        }
+        cycles = ESP.getCycleCount() - start;
+        printResult("makeNum", inputNames[input], ops, cycles);
+
+        // Year digits
+        start = ESP.getCycleCount();
+        for(int r = 0; r < BENCH_REPEAT; r++) {
+            for(int i = 0; i < BENCH_FRAMES; i++) {
+                disp.setYearDigits(frames[i][2] % 11, frames[i][3] % 11,
+                                   frames[i][4] % 11, frames[i][5] % 11);
+            }
+        }
+        cycles = ESP.getCycleCount() - start;
+        benchSink = disp._displayBuffer[3];
+        printResult("setYearDigits", inputNames[input], ops, cycles);
+
+        // Text rendering
+        start = ESP.getCycleCount();
+        for(int r = 0; r < BENCH_REPEAT; r++) {
+            for(int i = 0; i < BENCH_FRAMES; i++) {
+                for(int j = 0; j < DISP_LEN; j++) {
+                    text[j] = ' ' + (frames[i][j % BENCH_SLOTS] % 64);
+                }
+                text[DISP_LEN] = 0;
+                benchSink += disp.makeText(text, buf, (frames[i][9] & 1) ? CDT_COLON : 0);
+            }
+        }
+        cycles = ESP.getCycleCount() - start;
+        printResult("makeText", inputNames[input], ops, cycles);
+
+        #ifdef TC_HAVESPEEDO
+        // Speedo layout, for every display type (the firmware itself
+        // only contains the one selected by TC_SPEEDO_TYPE)
+        for(int t = SP_MIN_TYPE; t < SP_NUM_TYPES; t++) {
+            char name[24];
+            uint16_t sbuf[8];
+
+            start = ESP.getCycleCount();
+            for(int r = 0; r < BENCH_REPEAT; r++) {
+                for(int i = 0; i < BENCH_FRAMES; i++) {
+                    speedo_bench_funcs[t].setSpeed(sbuf, frames[i][0] % 100, frames[i][1] & 1);
+                }
+            }
+            cycles = ESP.getCycleCount() - start;
+            benchSink = sbuf[0];
+            snprintf(name, sizeof(name), "speedo%d.setSpeed", t);
+            printResult(name, inputNames[input], ops, cycles);
+
+            start = ESP.getCycleCount();
+            for(int r = 0; r < BENCH_REPEAT; r++) {
+                for(int i = 0; i < BENCH_FRAMES; i++) {
+                    text[0] = '0' + (frames[i][0] % 10);
+                    text[1] = 'A' + (frames[i][1] % 26);
+                    text[2] = 0;
+                    speedo_bench_funcs[t].setText(sbuf, text, frames[i][2] & 1);
+                }
+            }
+            cycles = ESP.getCycleCount() - start;
+            benchSink = sbuf[0];
+            snprintf(name, sizeof(name), "speedo%d.setText", t);
+            printResult(name, inputNames[input], ops, cycles);
+        }
+        #endif
+
+    }
+
+    Serial.println("bench,done");
+}
+
+/*
+ * Bus throughput: Full show() of all displays of 1 to TC_NUM_PANELS
+ * panels; in display index order (grouped by panel, as in dmx_loop())
+ * and, with more than one panel, in display ID order across panels
+ * (one multiplexer switch per display). Reports time per display and
+ * multiplexer switches per pass.
+ */
+void bench_bus()
+{
+    clockImage saved[TC_NUM_DISPLAYS];
+    char     input[16];
+    uint32_t start, cycles, ops, sw;
+
+    for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+        displays[i].getImage(&saved[i]);
+    }
+
+    for(int n = 1; n <= TC_NUM_PANELS; n++) {
+
+        snprintf(input, sizeof(input), "%dpanels", n);
+        ops = n * 3 * BENCH_BUS_REPEAT;
+
+        sw = clockDisplay::getMuxSwitches();
+        start = ESP.getCycleCount();
+        for(int r = 0; r < BENCH_BUS_REPEAT; r++) {
+            for(int d = 0; d < n * 3; d++) {
+                displays[d].show();
+            }
+        }
+        cycles = ESP.getCycleCount() - start;
+        printResult("bus-grouped", input, ops, cycles);
+        Serial.printf("bench,mux-switches,grouped,%s,%lu\n", input,
+            (unsigned long)((clockDisplay::getMuxSwitches() - sw) / BENCH_BUS_REPEAT));
+
+        if(n < 2)
+            continue;
+
+        sw = clockDisplay::getMuxSwitches();
+        start = ESP.getCycleCount();
+        for(int r = 0; r < BENCH_BUS_REPEAT; r++) {
+            for(int i = 0; i < 3; i++) {
+                for(int p = 0; p < n; p++) {
+                    displays[p * 3 + i].show();
+                }
+            }
+        }
+        cycles = ESP.getCycleCount() - start;
+        printResult("bus-interleaved", input, ops, cycles);
+        Serial.printf("bench,mux-switches,interleaved,%s,%lu\n", input,
+            (unsigned long)((clockDisplay::getMuxSwitches() - sw) / BENCH_BUS_REPEAT));
+    }
+
+    #ifdef TC_SOFTDIM
+    // Software dimming: PWM steps that blank or restore all fields
+    // of all displays, at each bus clock; the measured step time
+    // (both buses one after the other with TC_I2C_SPLIT) and the
+    // budgeted one, with the resulting steps and PWM frequency.
+    for(int c = 0; c < (int)(sizeof(dimClocks) / sizeof(dimClocks[0])); c++) {
+        uint32_t us;
+        int      steps;
+
+        Wire.setClock(dimClocks[c]);
+        #ifdef TC_I2C_SPLIT
+        Wire1.setClock(dimClocks[c]);
+        #endif
+
+        for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+            for(int f = 0; f < CDF_NUM; f++) {
+                displays[d].setFieldLevel(f, 1);
+            }
+        }
+
+        snprintf(input, sizeof(input), "%luHz", (unsigned long)dimClocks[c]);
+        ops = BENCH_BUS_REPEAT;
+        start = ESP.getCycleCount();
+        for(int r = 0; r < BENCH_BUS_REPEAT; r++) {
+            for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+                displays[d].setDimStep(!(r & 1));
+                displays[d].showChanged();
+            }
+        }
+        cycles = ESP.getCycleCount() - start;
+        printResult("softdim-step", input, ops, cycles);
+
+        us = dmx_dim_budget(dimClocks[c], &steps);
+        Serial.printf("bench,softdim-budget,%s,%lu,%d,%lu\n", input, (unsigned long)us, steps,
+            (unsigned long)((steps >= 2) ? 1000000 / (us * steps) : 0));
+    }
+
+    Wire.setClock(TC_I2C_CLOCK);
+    #ifdef TC_I2C_SPLIT
+    Wire1.setClock(TC_I2C_CLOCK);
+    #endif
+
+    for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+        for(int f = 0; f < CDF_NUM; f++) {
+            displays[d].setFieldLevel(f, 255);
+        }
+        displays[d].setDimStep(0);
+    }
+    #endif
+
+    for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+        displays[i].setImage(&saved[i]);
+        displays[i].show();
+        if(displays[i].isOn) {
+            displays[i].on();
+        } else {
+            displays[i].off();
+        }
+    }
+
+    Serial.println("bench,bus-done");
+}
+
+#endif  // TC_BENCH
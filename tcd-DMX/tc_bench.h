@@ -0,0 +1,19 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _TC_BENCH_H
+#define _TC_BENCH_H
+
+#ifdef TC_BENCH
+
+void bench_run();
+void bench_bus();
+
+#endif
+
+#endif
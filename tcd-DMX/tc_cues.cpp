@@ -0,0 +1,259 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Cue list
+ *
+ * A cue file on the SD card (/cues.txt) lists actions to be run at
+ * given times of day, without a DMX controller. The file is compiled
+ * at boot into an array sorted by time; the index of the next cue
+ * is kept, so checking for due cues once per second is O(1).
+ *
+ * File format: One cue per line, '#' starts a comment
+ *
+ *   <time> date   <displays> <month>/<day>/<year> <hour>:<minute>
+ *   <time> run    <displays> <month>/<day>/<year> <hour>:<minute> <rate>
+ *   <time> rtc    <displays>
+ *   <time> bright <displays> <brightness>
+ *   <time> scene  <scene>
+ *
+ * time:       hh:mm or hh:mm:ss (24 hours)
+ * displays:   DT, PT, LT, or several joined with '+' (eg DT+LT), or all
+ * hour:       0-23
+ * rate:       0-255, as the DMX rate channel
+ * brightness: 0 = off, 1-16 = darkest-brightest
+ * Cues with the same time are run in file order.
+ * -------------------------------------------------------------------
+ */
+
+#include "tc_global.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FS.h>
+
+#include "tc_cues.h"
+#include "tc_personality.h"
+
+#define CUE_MAX         128
+#define CUE_MAX_LINE    128
+
+static const char *cuefn = "/cues.txt";
+
+static cueEntry cues[CUE_MAX];
+static int      numCues = 0;
+static int      cueNext = 0;
+
+static const char *actionNames[] = {
+    "date", "run", "rtc", "bright", "scene"
+};
+
+/*
+ * Compiler
+ */
+
+static int findDisplays(char *names)
+{
+    char *t;
+    int mask = 0, i;
+
+    if(!strcasecmp(names, "all"))
+        return (1 << PERS_NUM_DISPLAYS) - 1;
+
+    for(t = strtok(names, "+"); t; t = strtok(NULL, "+")) {
+        for(i = 0; i < PERS_NUM_DISPLAYS; i++) {
+            if(!strcasecmp(t, persDisplayNames[i]))
+                break;
+        }
+        if(i == PERS_NUM_DISPLAYS)
+            return -1;
+        mask |= (1 << i);
+    }
+
+    return mask;
+}
+
+static bool compileError(int lineNo, const char *msg, const char *token)
+{
+    Serial.printf("%s line %d: %s (%s)\n", cuefn, lineNo, msg, token ? token : "");
+
+    return false;
+}
+
+static bool compileLine(char *line, int lineNo)
+{
+    cueEntry c;
+    char *tok, *t, *disp = NULL;
+    int h, m, s = 0, v, a;
+
+    if((t = strchr(line, '#'))) *t = 0;
+
+    if(!(tok = strtok(line, " \t")))
+        return true;
+
+    if(sscanf(tok, "%d:%d:%d", &h, &m, &s) < 2 || h < 0 || h > 23 || m < 0 || m > 59 || s < 0 || s > 59)
+        return compileError(lineNo, "Bad time", tok);
+
+    memset(&c, 0, sizeof(c));
+    c.time = (h * 60 + m) * 60 + s;
+
+    if(!(tok = strtok(NULL, " \t")))
+        return compileError(lineNo, "Missing action", NULL);
+    for(a = 0; a <= CA_SCENE; a++) {
+        if(!strcasecmp(tok, actionNames[a]))
+            break;
+    }
+    if(a > CA_SCENE)
+        return compileError(lineNo, "Bad action", tok);
+    c.action = a;
+
+    // (Displays are parsed after the line, strtok is not re-entrant)
+    if(a != CA_SCENE && !(disp = strtok(NULL, " \t")))
+        return compileError(lineNo, "Missing displays", NULL);
+
+    if(a == CA_DATE || a == CA_RUN) {
+        int mon, day, year, hour, min;
+        if(!(tok = strtok(NULL, " \t")) || sscanf(tok, "%d/%d/%d", &mon, &day, &year) != 3 ||
+           mon < 1 || mon > 12 || day < 1 || day > 31 || year < 0 || year > 9999)
+            return compileError(lineNo, "Bad date", tok);
+        if(!(tok = strtok(NULL, " \t")) || sscanf(tok, "%d:%d", &hour, &min) != 2 ||
+           hour < 0 || hour > 23 || min < 0 || min > 59)
+            return compileError(lineNo, "Bad time of date", tok);
+        c.date.year = year;
+        c.date.month = mon;
+        c.date.day = day;
+        c.date.hour = hour;
+        c.date.minute = min;
+    }
+
+    if(a == CA_RUN || a == CA_BRIGHT || a == CA_SCENE) {
+        if(!(tok = strtok(NULL, " \t")) || (v = atoi(tok)) < 0 || v > 255 ||
+           (a == CA_BRIGHT && v > 16) || (a == CA_SCENE && v < 1))
+            return compileError(lineNo, "Bad value", tok);
+        c.param = v;
+    }
+
+    if(disp && (v = findDisplays(disp)) <= 0)
+        return compileError(lineNo, "Bad displays", disp);
+    c.displays = disp ? v : 0;
+
+    if(numCues >= CUE_MAX)
+        return compileError(lineNo, "Too many cues", NULL);
+
+    // Insert sorted by time; after cues with the same time
+    for(v = numCues; v > 0 && cues[v - 1].time > c.time; v--) {
+        cues[v] = cues[v - 1];
+    }
+    cues[v] = c;
+    numCues++;
+
+    return true;
+}
+
+static bool compileFile()
+{
+    char line[CUE_MAX_LINE];
+    int len = 0, lineNo = 1, c;
+    bool ok = true;
+
+    File myFile = SD.open(cuefn, FILE_READ);
+
+    if(!myFile) {
+        Serial.printf("Failed to open %s\n", cuefn);
+        return false;
+    }
+
+    numCues = 0;
+
+    do {
+        c = myFile.read();
+        if(c < 0 || c == '\n') {
+            line[len] = 0;
+            if(!compileLine(line, lineNo)) {
+                ok = false;
+                break;
+            }
+            len = 0;
+            lineNo++;
+        } else if(c != '\r' && len < CUE_MAX_LINE - 1) {
+            line[len++] = c;
+        }
+    } while(c >= 0);
+
+    myFile.close();
+
+    if(!ok) numCues = 0;
+
+    return ok;
+}
+
+/*
+ * cues_setup()
+ *
+ * Compile the cue file from SD, if available.
+ * Must be called while SD is mounted.
+ */
+void cues_setup(bool haveSD)
+{
+    numCues = cueNext = 0;
+
+    if(!haveSD || !SD.exists(cuefn))
+        return;
+
+    if(compileFile()) {
+        Serial.printf("Cue list: %d cues\n", numCues);
+    } else {
+        Serial.println("Cue file not usable, cue list disabled");
+    }
+}
+
+int cues_count()
+{
+    return numCues;
+}
+
+/*
+ * Find the next cue at or after second of day sec
+ * (after a time change, or at boot)
+ */
+void cues_sync(uint32_t sec)
+{
+    int lo = 0, hi = numCues;
+
+    while(lo < hi) {
+        int mid = (lo + hi) / 2;
+        if(cues[mid].time < sec) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    cueNext = (lo < numCues) ? lo : 0;
+}
+
+/*
+ * Called once per second with the current second of day.
+ * Returns the number of cues due now; *first points to the first.
+ */
+int cues_due(uint32_t sec, const cueEntry **first)
+{
+    int num = 0;
+
+    if(!numCues || cues[cueNext].time != sec)
+        return 0;
+
+    *first = &cues[cueNext];
+
+    do {
+        num++;
+        cueNext++;
+    } while(cueNext < numCues && cues[cueNext].time == sec);
+
+    if(cueNext >= numCues) cueNext = 0;
+
+    return num;
+}
@@ -0,0 +1,40 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _TC_CUES_H
+#define _TC_CUES_H
+
+#include "clockdisplay.h"
+
+#define CUE_SECS_PER_DAY    (24UL * 60 * 60)
+
+// Cue actions
+enum : uint8_t {
+    CA_DATE = 0,        // Show date/time
+    CA_RUN,             // Free-running clock from date/time; param = rate
+    CA_RTC,             // Real time clock
+    CA_BRIGHT,          // param = brightness (0 = off, 1-16)
+    CA_SCENE            // param = scene
+};
+
+struct cueEntry {
+    uint32_t   time;        // Second of day
+    uint8_t    action;      // CA_xxx
+    uint8_t    displays;    // Bitmask
+    uint8_t    param;
+    dateStruct date;        // hour 0-23
+};
+
+void cues_setup(bool haveSD);
+
+int  cues_count();
+
+void cues_sync(uint32_t sec);
+int  cues_due(uint32_t sec, const cueEntry **first);
+
+#endif
@@ -12,9 +12,21 @@
 #include <esp_dmx.h>
 
 #include "tc_dmx.h"
+#include "tc_log.h"
+#include "tc_stats.h"
+#include "tc_personality.h"
+#include "tc_userpers.h"
+#include "tc_cues.h"
+#include "tc_trace.h"
+#ifdef TC_LEAN_RX
+#include "tc_dmxrx.h"
+#endif
 #ifdef TC_HAVESPEEDO
 #include "speeddisplay.h"
 #endif
+#ifdef TC_HAVESCENES
+#include "tc_scenes.h"
+#endif
 
 #define DEST_TIME_ADDR 0x71 // TC displays
 #define PRES_TIME_ADDR 0x72
@@ -25,14 +37,59 @@
 #define DS3231_ADDR    0x68 // DS3231 RTC
 #define PCF2129_ADDR   0x51 // PCF2129 RTC
 
-// The TC display objects
-clockDisplay destinationTime(DISP_DEST, DEST_TIME_ADDR);
-clockDisplay presentTime(DISP_PRES, PRES_TIME_ADDR);
-clockDisplay departedTime(DISP_LAST, DEPT_TIME_ADDR);
+static_assert(TC_NUM_PANELS >= 1 && TC_NUM_PANELS <= 8, "TC_NUM_PANELS must be 1-8");
+
+// The TC display objects; with more than one panel, panel n
+// is behind multiplexer channel n
+#if TC_NUM_PANELS > 1
+#define TC_MUX(n)   (n)
+#else
+#define TC_MUX(n)   CD_NO_MUX
+#endif
+
+#ifdef TC_I2C_SPLIT
+#define TC_WIRE(b)  ((b) ? &Wire1 : &Wire)
+#else
+#define TC_WIRE(b)  (&Wire)
+#endif
+
+#define TC_PANEL(n) { DISP_DEST, DEST_TIME_ADDR, TC_MUX(n), TC_WIRE(TC_BUS_DEST) }, \
+                    { DISP_PRES, PRES_TIME_ADDR, TC_MUX(n), TC_WIRE(TC_BUS_PRES) }, \
+                    { DISP_LAST, DEPT_TIME_ADDR, TC_MUX(n), TC_WIRE(TC_BUS_LAST) }
+
+clockDisplay displays[TC_NUM_DISPLAYS] = {
+    TC_PANEL(0),
+    #if TC_NUM_PANELS > 1
+    TC_PANEL(1),
+    #endif
+    #if TC_NUM_PANELS > 2
+    TC_PANEL(2),
+    #endif
+    #if TC_NUM_PANELS > 3
+    TC_PANEL(3),
+    #endif
+    #if TC_NUM_PANELS > 4
+    TC_PANEL(4),
+    #endif
+    #if TC_NUM_PANELS > 5
+    TC_PANEL(5),
+    #endif
+    #if TC_NUM_PANELS > 6
+    TC_PANEL(6),
+    #endif
+    #if TC_NUM_PANELS > 7
+    TC_PANEL(7),
+    #endif
+};
+
+// First panel
+clockDisplay& destinationTime = displays[DISP_DEST];
+clockDisplay& presentTime = displays[DISP_PRES];
+clockDisplay& departedTime = displays[DISP_LAST];
 
 // The speedo object
 #ifdef TC_HAVESPEEDO
-speedDisplay speedo(SPEEDO_ADDR);
+speedDisplay speedo(SPEEDO_ADDR, TC_WIRE(TC_BUS_SPEEDO));
 #endif
 
 // The RTC object
@@ -57,149 +114,485 @@ dmx_port_t dmxPort = 1;
 
 dmx_packet_t packet;
 
-uint8_t data[DMX_PACKET_SIZE];
-
+// Channel layout: See tc_personality.h. Defines are for the
+// standard personality, which has the largest footprint. 
+// Panels follow each other, each with a full footprint.
 #define DMX_ADDRESS               1
-#define DMX_CHANNELS_PER_DISPLAY 11
-#define DMX_CHANNELS (3 * DMX_CHANNELS_PER_DISPLAY)
+#define DMX_CHANNELS_PER_DISPLAY PERS_DISPLAY_SLOTS
+#define DMX_CHANNELS (PERS_NUM_DISPLAYS * DMX_CHANNELS_PER_DISPLAY)
+
+#define DMX_MODE_CHANNEL         (DMX_ADDRESS + PERS_GLOBAL_SLOT(PG_MODE, 0))  // one per display: DT, PT, LT
+#define DMX_MODE_CHANNELS        PERS_NUM_DISPLAYS
+
+#define DMX_RATE_CHANNEL         (DMX_ADDRESS + PERS_GLOBAL_SLOT(PG_RATE, 0))  // one per display: DT, PT, LT
+#define DMX_RATE_CHANNELS        PERS_NUM_DISPLAYS
+
+#define DMX_FOOTPRINT            PERS_FOOTPRINT
+
+static_assert(persFootprint(PERS_16BIT) <= DMX_FOOTPRINT, "16-bit personality exceeds standard footprint");
 
-#define DMX_SPEEDO_CHANNEL       57
+// Raw segment personality: The panels' slots are followed by the
+// speedo's; the channels below are not used.
+#ifdef TC_HAVESPEEDO
+#define DMX_RAW_SPEEDO_SLOTS    16
+#else
+#define DMX_RAW_SPEEDO_SLOTS     0
+#endif
+#define DMX_RAW_SPEEDO_CHANNEL  (DMX_ADDRESS + TC_NUM_PANELS * persFootprint(PERS_RAW))
+#define DMX_RAW_SLOTS           (TC_NUM_PANELS * persFootprint(PERS_RAW) + DMX_RAW_SPEEDO_SLOTS)
+
+// Channels below are moved behind the last panel
+#define DMX_PANEL_OFFS          ((TC_NUM_PANELS - 1) * DMX_FOOTPRINT)
+
+#define DMX_SPEEDO_CHANNEL      (57 + DMX_PANEL_OFFS)
 #define DMX_SPEEDO_CHANNELS       2
 
-#define DMX_VERIFY_CHANNEL       46    // must be set to DMX_VERIFY_VALUE
+#define DMX_SCENE_CHANNEL       (60 + DMX_PANEL_OFFS)    // Scene select, followed by scene capture
+#define DMX_SCENE_CHANNELS        2
+#define DMX_SCENE_BAND            8    // Channel values per scene
+#define DMX_SCENE_CAPTURE_FRAMES 20    // Frames a capture value must be held
+
+// Software dimming (TC_SOFTDIM): Per display (DT, PT, LT of each
+// panel) month, day, year, hour, minute; 0 = not dimmed, 1-255 = off
+// to full brightness
+#define DMX_DIM_CHANNEL         (62 + DMX_PANEL_OFFS)
+#define DMX_DIM_CHANNELS        (TC_NUM_DISPLAYS * CDF_NUM)
+
+// Blink reference (TC_BLINK_LOCK): A rise from below 128 to 128 or
+// above marks the start of a second
+#define DMX_BLINK_CHANNEL       (59 + DMX_PANEL_OFFS)
+
+#define DMX_VERIFY_CHANNEL      (46 + DMX_PANEL_OFFS)    // must be set to DMX_VERIFY_VALUE
 #define DMX_VERIFY_VALUE        100  
 
-#if defined(DMX_USE_VERIFY) && (DMX_ADDRESS < DMX_VERIFY_CHANNEL)
-#define DMX_SLOTS_TO_RECEIVE (DMX_VERIFY_CHANNEL + 1)
+// Alternate start codes (ANSI E1.11)
+#define DMX_SC_TEXT            0x17    // Text packet
+#define DMX_SC_MANUF           0x91    // Manufacturer ID; used for timecode
+#define DMX_SC_SIP             0xCF    // System information packet
+
+// Packet timing (250kbps; break and mark after break as sent by
+// most controllers)
+#define DMX_SLOT_US             44
+#define DMX_BREAK_US           190
+
+// ESTA manufacturer ID for our timecode packets (0x7ff0-0x7fff are
+// reserved for prototyping/experimental use)
+#define DMX_TIMECODE_MANUF_ID  0x7ff0
+
+#ifdef DMX_USE_VERIFY
+#define DMX_SLOTS_TO_RECEIVE ((DMX_ADDRESS < DMX_VERIFY_CHANNEL) ? DMX_VERIFY_CHANNEL + 1 : \
+                                                                DMX_ADDRESS + TC_NUM_PANELS * DMX_FOOTPRINT)
 #else
-#define DMX_SLOTS_TO_RECEIVE (DMX_ADDRESS + DMX_CHANNELS)
+#define DMX_SLOTS_TO_RECEIVE (DMX_ADDRESS + TC_NUM_PANELS * DMX_FOOTPRINT)
+#endif
+
+static_assert(DMX_SCENE_CHANNEL + DMX_SCENE_CHANNELS <= DMX_PACKET_SIZE, "Too many panels for one universe");
+#ifdef TC_SOFTDIM
+static_assert(DMX_DIM_CHANNEL + DMX_DIM_CHANNELS <= DMX_PACKET_SIZE, "Too many panels for software dimming");
 #endif
 
 #ifdef TC_HAVESPEEDO
 #define DMX_SLOTS_TO_RECEIVE_SP (DMX_SPEEDO_CHANNEL + DMX_SPEEDO_CHANNELS)
 #endif
+#ifdef TC_HAVESCENES
+#define DMX_SLOTS_TO_RECEIVE_SC (DMX_SCENE_CHANNEL + DMX_SCENE_CHANNELS)
+#endif
+#ifdef TC_SOFTDIM
+#define DMX_SLOTS_TO_RECEIVE_DIM (DMX_DIM_CHANNEL + DMX_DIM_CHANNELS)
+#endif
+#ifdef TC_BLINK_LOCK
+#define DMX_SLOTS_TO_RECEIVE_BL (DMX_BLINK_CHANNEL + 1)
+#endif
+#define DMX_SLOTS_TO_RECEIVE_RAW (DMX_ADDRESS + DMX_RAW_SLOTS)
+
+static_assert(DMX_SLOTS_TO_RECEIVE_RAW <= DMX_PACKET_SIZE, "Too many panels for raw segment personality");
 
 int dmx_slots_to_receive = DMX_SLOTS_TO_RECEIVE;
+static int slotsBase = DMX_SLOTS_TO_RECEIVE;      // For all but the raw personality
+
+// Packet data; slot DMX_ADDRESS is word-aligned for the change
+// detection. With TC_LEAN_RX, data points to the receiver's
+// buffer holding the current packet.
+#define DMX_DATA_ALIGN  ((4 - (DMX_ADDRESS & 3)) & 3)
+
+static uint32_t dataWords[(DMX_DATA_ALIGN + DMX_PACKET_SIZE + 3) / 4];
+uint8_t *data = (uint8_t *)dataWords + DMX_DATA_ALIGN;
+
+// Panels' window: The slots of all panels' footprints, starting at
+// DMX_ADDRESS. Compared word-wise with the previous frame; slotChg
+// has a bit per slot (relative to DMX_ADDRESS) that changed.
+#define DMX_WIN_MAX     (DMX_PACKET_SIZE - DMX_ADDRESS)
+
+static int      winSlots = TC_NUM_PANELS * DMX_FOOTPRINT;
+static uint32_t winPrev[(DMX_WIN_MAX + 3) / 4];
+static uint32_t slotChg[(DMX_WIN_MAX + 31) / 32];
+static bool     winForce = true;
 
-uint8_t cachedt[DMX_CHANNELS_PER_DISPLAY];
-uint8_t cachept[DMX_CHANNELS_PER_DISPLAY];
-uint8_t cachelt[DMX_CHANNELS_PER_DISPLAY];
 #ifdef TC_HAVESPEEDO
 uint8_t cachesp[DMX_SPEEDO_CHANNELS];
 #endif
+#ifdef TC_HAVESCENES
+uint8_t cachesc[DMX_SCENE_CHANNELS];
+#endif
+#ifdef TC_SOFTDIM
+uint8_t cachedim[DMX_DIM_CHANNELS];
+#endif
+uint8_t cacheuser[TC_NUM_DISPLAYS][UP_FIELDS];
 
-// DMX addresses for the displays
-#define DT_BASE DMX_ADDRESS
-#define PT_BASE (DT_BASE+DMX_CHANNELS_PER_DISPLAY)
-#define LT_BASE (PT_BASE+DMX_CHANNELS_PER_DISPLAY)
-
-#define SP_BASE DMX_SPEEDO_CHANNEL
+// Current built-in personality (selected through RDM)
+static int persCur = PERS_STANDARD;
+static int dispSlots = DMX_CHANNELS_PER_DISPLAY;
+static int panelSlots = DMX_FOOTPRINT;
+static int modeChannel = DMX_MODE_CHANNEL;
+static int rateChannel = DMX_RATE_CHANNEL;
 
-static const uint8_t monthRanges[256] = {
-     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-     1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,
-     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
-     3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,
-     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
-     5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,
-     6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6, 
-     7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
-     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
-     9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 
-    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12
-};    
-static const uint8_t yearRanges[256] = {
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   // 0-23
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,      // 24-46
-    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,      // 47-69
-    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,   // 70-93
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,      // 94-116
-    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,      // 117-139
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,      // 140-162
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,   // 163-186
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,      // 187-209
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,      // 210-232
-   10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10       // 233-255
-};
+// DMX address for display index d (panel * 3 + display ID)
+#define DISP_BASE(d) (DMX_ADDRESS + ((d) / 3) * panelSlots + ((d) % 3) * dispSlots)
 
-static const uint8_t hourRanges[256] = {
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,        // 0-18
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,           // 19-36
-    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,           // 37-54
-    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,           // 55-72
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,           // 73-90
-    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,           // 91-108
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,           // 109-126
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,           // 127-144
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,           // 145-162
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,           // 163-180
-   10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,           // 181-198
-   11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,           // 199-216
-   12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,           // 217-234
-   13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13   // 235-255
-};
+#define SP_BASE DMX_SPEEDO_CHANNEL
 
-static const uint8_t minRanges[256] = {
-    0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,  // 0-16
-    4, 4, 4, 4, 5, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,  // 17-33
-    8, 8, 8, 8, 9, 9, 9, 9,10,10,10,10,10,11,11,11,11,  // 34-50
-   12,12,12,12,13,13,13,13,14,14,14,14,15,15,15,15,15,  // 51-67
-   16,16,16,16,17,17,17,17,18,18,18,18,19,19,19,19,     // 68-83
-   20,20,20,20,20,21,21,21,21,22,22,22,22,23,23,23,23,  // 84-100
-   24,24,24,24,25,25,25,25,25,26,26,26,26,27,27,27,27,  // 101-117
-   28,28,28,28,29,29,29,29,30,30,30,30,30,31,31,31,31,  // 118-134
-   32,32,32,32,33,33,33,33,34,34,34,34,35,35,35,35,35,  // 135-151
-   36,36,36,36,37,37,37,37,38,38,38,38,39,39,39,39,     // 152-167
-   40,40,40,40,40,41,41,41,41,42,42,42,42,43,43,43,43,  // 168-184
-   44,44,44,44,45,45,45,45,45,46,46,46,46,47,47,47,47,  // 185-201
-   48,48,48,48,49,49,49,49,50,50,50,50,50,51,51,51,51,  // 202-218
-   52,52,52,52,53,53,53,53,54,54,54,54,55,55,55,55,55,  // 219-235
-   56,56,56,56,57,57,57,57,58,58,58,58,59,59,59,59,     // 236-251
-   60,60,60,60                                          // 252-255
-};
+// Display modes (set through mode channel; see persCapsMode in tc_personality.h)
+#define DM_DMX    0     // 0-31:  Date/time from DMX channels
+#define DM_RTC    1     // 32-63: Real time from RTC
+#define DM_FREERUN 2    // 64-95: Free-running clock, seeded from DMX channels
+#define DM_TIMECODE 3   // 96-127: Date from DMX channels, time from timecode
+#define DM_NUM    4     // Values above are reserved (treated as DM_DMX)
+
+// Free-run engine tick (hardware timer)
+#define FR_TICK_MS 10
+
+// DMX task (TC_DMX_TASK)
+#define DMX_TASK_CORE      1
+#define DMX_TASK_PRIO      3
+#define DMX_TASK_WAIT_MS   5    // Max wait for a packet
+
+// Loop scheduler (see dmx_loop): Task budgets (us). A task with a
+// priority below SCHED_PRIO_FRAME is deferred if its budget would
+// make the pass take longer than a DMX frame, but for no more than
+// SCHED_DEFER_MAX passes in a row.
+#define SCHED_BUDGET_RECEIVE  1500
+#define SCHED_BUDGET_BLINK     300
+#define SCHED_BUDGET_EFFECTS  1500
+#define SCHED_BUDGET_RENDER  (TC_NUM_PANELS * 6000 + 2000)
+#define SCHED_BUDGET_HOUSE    1000
+#define SCHED_PRIO_FRAME         2
+#define SCHED_DEFER_MAX          8
+
+// Blink phase lock (TC_BLINK_LOCK): PLL gains are 1/BLINK_KP and
+// 1/BLINK_KI; phase errors (us) over BLINK_JUMP_US are corrected at
+// once; the lock is lost after BLINK_TIMEOUT_MS without a reference.
+// While locked, the phase error is logged every BLINK_REPORT_S seconds.
+#define BLINK_PERIOD_US    1000000
+#define BLINK_KP                 4
+#define BLINK_KI                32
+#define BLINK_JUMP_US        50000
+#define BLINK_TIMEOUT_MS      3000
+#define BLINK_REPORT_S          10
+
+// Software dimming (TC_SOFTDIM): Bus budget of a PWM step, see
+// dmx_dim_budget()
+#define DIM_STEP_BYTES          18    // Address, register, all columns
+#define DIM_MUX_BYTES            2
+#define DIM_GAP_US              50    // Driver overhead per transaction
+#define DIM_MARGIN_PCT          25
+#define DIM_STEP_MIN_US       1000    // The DMX task polls once per ms at most
+#define DIM_MIN_HZ             100    // PWM frequency without visible flicker
+#define DIM_STEPS_MAX           16
 
 unsigned long        powerupMillis;
 
 static bool          dmxIsConnected = false;
 static unsigned long lastDMXpacket;
+static TickType_t    rxWait = 0;     // Wait for packet; 0 = poll
+static int           rxSize = 0;     // Size of packet received in this pass
+
+// Work handed from task to task
+static uint32_t      pendDisp = 0;   // Displays to show (bitmask by display index)
+static uint32_t      pendMode = 0;   // Displays whose mode changed
+static bool          pendSpeedo = false;
+static uint32_t      dimOnly = 0;    // Displays shown for a PWM step only (TC_SOFTDIM)
 
 // For tracking second changes
 static bool          x = false;  
 static bool          y = false;
 
-static int           kpleds = 0;
+static uint32_t      kpleds = 0;
+
+#ifdef TC_BLINK_LOCK
+// Blink phase lock: Colons are on for the first half of each second,
+// which starts blPhase us after a falling edge of the 1Hz signal
+static volatile uint32_t blSqwFall = 0;      // Time of last falling edge (us)
+static int32_t       blPhase = 0;
+static int32_t       blFreq = 0;             // Phase drift per second (us)
+static unsigned long blLastRef = 0;
+static bool          blLocked = false;
+static bool          blColon = false;
+static int           blChanPrev = -1;        // Reference channel's last value (-1 = none)
+#endif
+
+static bool          haveRTC = false;
+static bool          rtcUpdate = false;
+static uint8_t       dispMode[TC_NUM_DISPLAYS] = { 0 };     // DM_DMX
+static uint8_t       rtcLastMin = 255;
+
+// Free-run clock engine
+static struct {
+    uint16_t year;
+    uint8_t  month;
+    uint8_t  day;
+    uint8_t  hour;
+    uint8_t  minute;
+    int32_t  accum;     // Clock ms since last minute change
+    int32_t  rate;      // Clock ms per real ms; negative = reverse
+    bool     reseed;
+    uint8_t  seed[PF_DATETIME_NUM];
+} frState[TC_NUM_DISPLAYS];
+
+static hw_timer_t            *frTimer = NULL;
+static volatile uint32_t     frTicks = 0;
+static uint32_t              frLastTicks = 0;
+
+#ifdef TC_SOFTDIM
+// Software dimming: The timer advances the PWM step
+static hw_timer_t            *dimTimer = NULL;
+static volatile uint32_t     dimTicks = 0;
+static uint32_t              dimLastTicks = 0;
+static int                   dimSteps = 0;     // Steps per PWM period; 0 = no dimming
+#endif
+
+// Alternate start code handlers; return bitmask of displays to show
+typedef int (*scHandler_t)(int size);
+
+static int scUnknown(int size);
+static int scText(int size);
+static int scSIP(int size);
+static int scManuf(int size);
+
+static const scHandler_t scHandlers[] = {
+    scUnknown, scText, scSIP, scManuf
+};
+static uint8_t       scIndex[256];      // Start code -> scHandlers index
+
+// Text packets: Displays showing text (bitmask)
+static uint32_t      textHold = 0;
+
+// Timecode
+static bool          tcValid = false;
+static uint8_t       tcHour, tcMinute;
+#ifdef TC_BLINK_LOCK
+static uint8_t       tcSecond = 255;
+#endif
+
+// System information packets
+static struct {
+    uint8_t  seq;
+    uint8_t  universe;
+    uint8_t  procLevel;
+    uint8_t  swVersion;
+    uint16_t pktLength;
+    uint16_t pktCount;
+    uint16_t manufId;
+    uint16_t prevChecksum;
+    uint32_t received;
+    uint32_t badSIP;
+    uint32_t badChecksum;
+} sipInfo;
+static bool          sipActive = false;
+
+// Statistics
+tcStats              stats;
+static int64_t       rxBreak;           // Time of current packet's break (us)
+static unsigned long statsLastSecond = 0;
+static uint32_t      statsLastFrames = 0;
+static int           statsTempCount = 0;
+
+// RDM parameters for statistics
+static const struct {
+    rdm_pid_t   pid;
+    const char *desc;
+    const char *format;
+    void       *param;
+    uint8_t     size;
+} statsPIDs[] = {
+    { TCD_PID_FPS,         "Frames per second",      "d$",        &stats.fps,           4 },
+    { TCD_PID_DMX_ERRORS,  "DMX errors by type",     "dddddddd$", stats.dmxErrors,      4 * STATS_NUM_ERRTYPES },
+    { TCD_PID_DECODE_TIME, "Decode time (us)",       "dddddddd$", stats.decodeTime,     4 * 2 * STATS_NUM_DISPLAYS },
+    { TCD_PID_BUS_TIME,    "Bus time (us)",          "dddddddd$", stats.busTime,        4 * 2 * STATS_NUM_DISPLAYS },
+    { TCD_PID_I2C_ERRORS,  "I2C errors",             "d$",        &stats.i2cErrors,     4 },
+    { TCD_PID_LOOP_STATS,  "Loop overruns/max (us)", "dd$",       &stats.loopOverruns,  4 * 2 },
+    { TCD_PID_RTC_TEMP,    "RTC temperature",        "d$",        &stats.rtcTemp,       4 },
+    { TCD_PID_UPTIME,      "Uptime (s)",             "d$",        &stats.uptime,        4 },
+    { TCD_PID_BUS_UTIL,    "Bus utilization (.01%)", "dd$",       stats.busUtil,        4 * STATS_NUM_BUSES },
+    { TCD_PID_RX_STATS,    "Rx ISR/latency",         "dddd$",     &stats.rxIsrMax,      4 * 4 },
+    { TCD_PID_TASK_STATS,  "Task max/overruns/misses","ddddddddddddddd$", stats.taskTimeMax, 4 * 3 * STATS_NUM_TASKS },
+    { TCD_PID_I2C_TRAFFIC, "I2C bytes/transactions", "ddddd$",    &stats.i2cBytes,      4 * 5 }
+};
+static uint16_t      lastChecksum;
+static int           lastSize;
 
 #ifdef TC_HAVESPEEDO
 static bool          useSpeedo = true;
 #endif
 
-// Forward declarations
-static void setDisplay(clockDisplay *display, int base, int kpbit);
+// I2C buses: Display update time (us) since last stats update
+static uint32_t      busBusy[STATS_NUM_BUSES];
+
+// Second I2C bus: The displays on bus 1 are shown by the bus 1
+// task, concurrently with the displays on bus 0.
+#ifdef TC_I2C_SPLIT
+#define BUS1_TASK_CORE     0
+#define BUS1_TASK_PRIO     2
+
+static TaskHandle_t      bus1Task = NULL;
+static TaskHandle_t      bus1Caller = NULL;
+static uint32_t          bus1Disps = 0;     // Displays on bus 1 (bitmask)
+static volatile uint32_t bus1Mask;
+static volatile bool     bus1Speedo;
+#endif
+
+// Warm restart: Rendered state, kept in RTC slow memory across
+// resets other than power-on (brownout, watchdog, panic)
+#define WS_MAGIC 0x53574354     // "TCWS"
+
+struct warmState_t {
+    uint32_t   magic;
+    uint16_t   size;
+    uint32_t   kpleds;
+    clockImage disp[TC_NUM_DISPLAYS];
+    #ifdef TC_HAVESPEEDO
+    speedImage speedo;
+    #endif
+    uint32_t   checksum;
+};
+static RTC_NOINIT_ATTR warmState_t warmState;
+static bool          warmDirty = false;
+
+// Cue list
+static bool          cuesActive = false;
+static bool          cueSynced = false;
+static uint32_t      cueLastSec = 0;
+
+// Scene shown instead of DMX data (0 = none)
+static int           sceneCur = 0;
+#ifdef TC_HAVESCENES
+static int           sceneCapture = 0;
+static int           sceneCaptureCnt = 0;
+static bool          sceneSeen = false;
+static sceneData     scenePend;             // Captured, to be stored by taskHouse
+static int           scenePendNum = 0;
+#endif
+
+// Forward declarations; "did" is the display index (panel * 3 + display ID)
+static void setDisplay(clockDisplay *display, int did, int base);
+static void applyDisplay(clockDisplay *display, int did, const uint8_t *val);
+static void decodeDisplay(clockDisplay *display, int did, const uint8_t *val);
+static uint32_t setDisplayMode(int did, int mode);
+static uint32_t setUserDisplays(const uint8_t *src, uint32_t *modeChg);
+static uint32_t setRawDisplays();
+static void checkPersonality();
+static void setDisplayDateTime(clockDisplay *display, int year, int month, int day, int hour, int minute);
+static void setDisplayTime(clockDisplay *display, int hour, int minute);
+static bool frAdvance(int did, uint32_t ticks);
+static void frShow(clockDisplay *display, int did);
+static void showDisplay(clockDisplay *display, int did);
+static void showDisplays(uint32_t mask, bool spd);
+#ifndef TC_LEAN_RX
+static void readWindows(int size);
+#endif
+static void detectChanges();
+static bool slotsChanged(int first, int num);
+static void updateStats();
+static void updateLatency();
+#ifdef TC_BLINK_LOCK
+static void blinkReference(uint32_t tr);
+static void blinkChannel();
+static void blinkColons();
+#endif
+#ifdef TC_SOFTDIM
+static void setFieldLevels();
+static uint32_t dimStep();
+#endif
+static void busTraffic(uint32_t *bytes, uint32_t *trans);
+static void taskReceive();
+static void taskBlink();
+static void taskEffects();
+static void taskRender();
+static void taskHouse();
+static void schedSetup();
+static int  frDecodeRate(uint8_t val);
+static uint32_t checkCues();
+static bool warmRestore();
+static void warmSave();
 #ifdef TC_HAVESPEEDO
 static void setSpeedoDisplay(speedDisplay *display, int base);
+static void showSpeedo();
+#endif
+#ifdef TC_I2C_SPLIT
+static void bus1TaskFunc(void *parameter);
+#endif
+#ifdef TC_HAVESCENES
+static void handleScenes();
+static void storeScene();
+static void recallScene(const sceneData *sd);
 #endif
 
 static void startDisplays()
 {
-    presentTime.begin();
-    destinationTime.begin();
-    departedTime.begin();
+    for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+        displays[i].begin();
+    }
 }
 
 static void invalidateCache()
 {
-    for(int i = 0; i < DMX_CHANNELS_PER_DISPLAY; i++) {
-        cachedt[i] = cachept[i] = cachelt[i] = rand() % 255;
-    }
+    // All slots of the panels' window count as changed in the next frame
+    winForce = true;
+
+    #ifdef TC_BLINK_LOCK
+    // The next frame's reference channel is not an edge
+    blChanPrev = -1;
+    #endif
 
     #ifdef TC_HAVESPEEDO
     for(int i = 0; i < DMX_SPEEDO_CHANNELS; i++) {
         cachesp[i] = rand() % 255;
     }
     #endif
+
+    #ifdef TC_HAVESCENES
+    for(int i = 0; i < DMX_SCENE_CHANNELS; i++) {
+        cachesc[i] = rand() % 255;
+    }
+    #endif
+
+    #ifdef TC_SOFTDIM
+    for(int i = 0; i < DMX_DIM_CHANNELS; i++) {
+        cachedim[i] = rand() % 255;
+    }
+    #endif
+
+    // Decoded values: 255 is out of range for all but mode and rate
+    memset(cacheuser, 255, sizeof(cacheuser));
+}
+
+static void IRAM_ATTR frTimerISR()
+{
+    frTicks++;
+}
+
+#ifdef TC_SOFTDIM
+static void IRAM_ATTR dimTimerISR()
+{
+    dimTicks++;
+}
+#endif
+
+#ifdef TC_BLINK_LOCK
+static void IRAM_ATTR sqwFallISR()
+{
+    blSqwFall = micros();
 }
+#endif
 
 
 /*********************************************************************************
@@ -213,30 +606,39 @@ void dmx_boot()
     // Start the displays early to clear them
     startDisplays();
 
-    presentTime.set1224(false);
-    destinationTime.set1224(false);
-    departedTime.set1224(false);
+    for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+        displays[i].set1224(false);
+    }
 
-    destinationTime.setFromStruct(&defDestinationTime);
-    presentTime.setFromStruct(&defPresentTime);
-    departedTime.setFromStruct(&defDepartedTime);
+    // After a warm reset, show what was shown before; otherwise
+    // the defaults.
+    if(!warmRestore()) {
+        for(int i = 0; i < TC_NUM_DISPLAYS; i += 3) {
+            displays[i + DISP_DEST].setFromStruct(&defDestinationTime);
+            displays[i + DISP_PRES].setFromStruct(&defPresentTime);
+            displays[i + DISP_LAST].setFromStruct(&defDepartedTime);
+        }
+    }
 
-    // Init color LEDs, keep them off
+    // Init color LEDs, keep them off (unless restored)
     pinMode(LEDS_PIN, OUTPUT);
-    digitalWrite(LEDS_PIN, LOW);
+    digitalWrite(LEDS_PIN, kpleds ? HIGH : LOW);
 
     // Init white LED, keep it off
     pinMode(WHITE_LED_PIN, OUTPUT);
     digitalWrite(WHITE_LED_PIN, LOW);
 
     #ifdef TC_HAVESPEEDO
-    if(!speedo.begin(TC_SPEEDO_TYPE)) {
+    if(!speedo.begin()) {
         useSpeedo = false;
         #ifdef TC_DBG
         Serial.println("Speedo not found");
         #endif
     } else {
         speedo.setDot(true);
+        if(warmState.magic == WS_MAGIC) {
+            speedo.setImage(&warmState.speedo);
+        }
         if(dmx_slots_to_receive < DMX_SLOTS_TO_RECEIVE_SP) {
             dmx_slots_to_receive = DMX_SLOTS_TO_RECEIVE_SP;
         }
@@ -255,6 +657,7 @@ void dmx_boot()
 
 void dmx_setup() 
 {
+    #ifndef TC_LEAN_RX
     dmx_config_t config = {
       .interrupt_flags = DMX_INTR_FLAGS_DEFAULT,
       .root_device_parameter_count = 32,
@@ -265,10 +668,54 @@ void dmx_setup()
       .software_version_label = "TCD-DMXv1",
       .queue_size_max = 32
     };
-    dmx_personality_t personalities[] = {
-        {DMX_CHANNELS, "TCD Personality"}
+    dmx_personality_t personalities[PERS_NUM] = {
+        {TC_NUM_PANELS * persFootprint(PERS_STANDARD), persPersonalities[PERS_STANDARD].desc},
+        {TC_NUM_PANELS * persFootprint(PERS_16BIT),    persPersonalities[PERS_16BIT].desc},
+        {DMX_RAW_SLOTS,                                persPersonalities[PERS_RAW].desc}
     };
-    int personality_count = 1;
+    int personality_count = PERS_NUM;
+    #endif
+
+    if(userpers_active() && TC_NUM_PANELS * userpers_footprint() > DMX_WIN_MAX) {
+        Serial.printf("User personality: Footprint %d too large for %d panels, using built-in personality\n",
+                      userpers_footprint(), TC_NUM_PANELS);
+        userpers_reject();
+    }
+
+    if(userpers_active()) {
+        winSlots = min(TC_NUM_PANELS * userpers_footprint(), DMX_WIN_MAX);
+        #ifndef TC_LEAN_RX
+        personalities[0].footprint = TC_NUM_PANELS * userpers_footprint();
+        personalities[0].description = "TCD User Personality";
+        personality_count = 1;
+        #endif
+        if(dmx_slots_to_receive < DMX_ADDRESS + TC_NUM_PANELS * userpers_footprint()) {
+            dmx_slots_to_receive = DMX_ADDRESS + TC_NUM_PANELS * userpers_footprint();
+        }
+    }
+
+    #ifdef TC_HAVESCENES
+    scenes_setup();
+    if(dmx_slots_to_receive < DMX_SLOTS_TO_RECEIVE_SC) {
+        dmx_slots_to_receive = DMX_SLOTS_TO_RECEIVE_SC;
+    }
+    #endif
+
+    #ifdef TC_SOFTDIM
+    if(dmx_slots_to_receive < DMX_SLOTS_TO_RECEIVE_DIM) {
+        dmx_slots_to_receive = DMX_SLOTS_TO_RECEIVE_DIM;
+    }
+    #endif
+
+    #ifdef TC_BLINK_LOCK
+    if(dmx_slots_to_receive < DMX_SLOTS_TO_RECEIVE_BL) {
+        dmx_slots_to_receive = DMX_SLOTS_TO_RECEIVE_BL;
+    }
+    #endif
+
+    // The raw segment personality's slots are added by checkPersonality()
+    // when it is selected
+    slotsBase = dmx_slots_to_receive;
 
     Serial.println(F("Time Circuits Display DMX version " TC_VERSION " " TC_VERSION_EXTRA));
     Serial.println(F("(C) 2024 Thomas Winischhofer (A10001986)"));
@@ -282,12 +729,27 @@ void dmx_setup()
     #else
     Serial.println("Speedo support is disabled");
     #endif
+    #if TC_NUM_PANELS > 1
+    Serial.printf("%d panels, multiplexer at 0x%02x\n", TC_NUM_PANELS, TC_MUX_ADDR);
+    #endif
+
+    #ifdef TC_I2C_SPLIT
+    for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+        static const uint8_t dispBus[3] = { TC_BUS_DEST, TC_BUS_PRES, TC_BUS_LAST };
+        if(dispBus[i % 3]) bus1Disps |= (1 << i);
+    }
+    xTaskCreatePinnedToCore(bus1TaskFunc, "bus1", 2048, NULL, BUS1_TASK_PRIO, &bus1Task, BUS1_TASK_CORE);
+    Serial.println("Using second I2C bus");
+    #endif
 
     // Pin for monitoring seconds from RTC
     pinMode(SECONDS_IN_PIN, INPUT_PULLDOWN);
+    #ifdef TC_BLINK_LOCK
+    attachInterrupt(digitalPinToInterrupt(SECONDS_IN_PIN), sqwFallISR, FALLING);
+    #endif
 
     // RTC setup
-    if(!rtc.begin(powerupMillis)) {
+    if(!(haveRTC = rtc.begin(powerupMillis))) {
         Serial.println("RTC not found, no 1Hz oscillator available");
     }
     if(rtc.lostPower()) {
@@ -298,11 +760,79 @@ void dmx_setup()
     // Turn on the RTC's 1Hz clock output
     rtc.clockOutEnable();
 
+    // Cue list needs the RTC
+    cuesActive = haveRTC && cues_count();
+
     invalidateCache();
+
+    // Alternate start code dispatch table
+    memset(scIndex, 0, sizeof(scIndex));
+    scIndex[DMX_SC_TEXT]  = 1;
+    scIndex[DMX_SC_SIP]   = 2;
+    scIndex[DMX_SC_MANUF] = 3;
+
+    // Timer for free-running clocks
+    frTimer = timerBegin(0, 80, true);                  // 1MHz
+    timerAttachInterrupt(frTimer, &frTimerISR, true);
+    timerAlarmWrite(frTimer, FR_TICK_MS * 1000, true);
+    timerAlarmEnable(frTimer);
+
+    #ifdef TC_SOFTDIM
+    // Timer for software dimming, as fast as the bus allows
+    {
+        uint32_t stepUs = dmx_dim_budget(TC_I2C_CLOCK, &dimSteps);
+
+        if(dimSteps < 2) {
+            dimSteps = 0;
+            Serial.printf("Software dimming disabled, bus too slow (%lu us per step)\n", (unsigned long)stepUs);
+        } else {
+            dimTimer = timerBegin(1, 80, true);         // 1MHz
+            timerAttachInterrupt(dimTimer, &dimTimerISR, true);
+            timerAlarmWrite(dimTimer, stepUs, true);
+            timerAlarmEnable(dimTimer);
+            Serial.printf("Software dimming: %d steps of %lu us (%lu Hz)\n", dimSteps,
+                          (unsigned long)stepUs, (unsigned long)(1000000 / (stepUs * dimSteps)));
+        }
+    }
+    #endif
   
     // Start the DMX stuff
+    #ifdef TC_LEAN_RX
+    // Receive only: Transceiver's driver off, receiver on
+    pinMode(enablePin, OUTPUT);
+    digitalWrite(enablePin, LOW);
+    dmxrx_setup(receivePin, dmx_slots_to_receive, DMX_DATA_ALIGN);
+    Serial.println("Using lean DMX receiver, no RDM");
+    #else
     dmx_driver_install(dmxPort, &config, personalities, personality_count);
     dmx_set_pin(dmxPort, transmitPin, receivePin, enablePin);
+    #endif
+
+    // Personality is kept by the driver across reboots
+    checkPersonality();
+
+    #ifndef TC_LEAN_RX
+
+    // Register RDM parameters for statistics
+    for(int i = 0; i < (int)(sizeof(statsPIDs) / sizeof(statsPIDs[0])); i++) {
+        rdm_pid_description_t desc = {
+            .pid = statsPIDs[i].pid,
+            .pdl_size = statsPIDs[i].size,
+            .data_type = RDM_DS_NOT_DEFINED,
+            .cc = RDM_CC_GET,
+            .unit = RDM_UNITS_NONE,
+            .prefix = RDM_PREFIX_NONE,
+            .min_value = 0,
+            .max_value = 0xffffffff,
+            .default_value = 0
+        };
+        strncpy(desc.description, statsPIDs[i].desc, 32);
+        rdm_register_manufacturer_specific_simple(dmxPort, desc, statsPIDs[i].param,
+                            statsPIDs[i].format, NULL, NULL);
+    }
+    #endif
+
+    schedSetup();
 }
 
 
@@ -312,109 +842,400 @@ void dmx_setup()
  *
  *********************************************************************************/
 
+/*
+ * The loop is a cooperative scheduler: Each pass waits for a packet
+ * (which does not count as run time), then runs the tasks in
+ * schedTasks by priority (highest first; in table order if equal),
+ * each one when it is due. Every task's run time is checked against
+ * its budget. A pass taking longer than one DMX frame is a deadline
+ * miss, which is charged to the task that overran its budget the most.
+ * A task with a priority below SCHED_PRIO_FRAME is deferred to the
+ * next pass if the pass so far plus the task's budget would exceed
+ * a frame. Changes made by a task are shown by Render in the next
+ * pass if Render already ran (eg those of Effects).
+ */
+static const struct {
+    void     (*run)();
+    uint8_t  prio;
+    uint16_t period;        // ms; 0 = every pass
+    uint32_t budget;        // us
+} schedTasks[STATS_NUM_TASKS] = {
+    { taskReceive, 2,  0, SCHED_BUDGET_RECEIVE },
+    { taskBlink,   2,  0, SCHED_BUDGET_BLINK   },
+    { taskEffects, 1,  0, SCHED_BUDGET_EFFECTS },
+    { taskRender,  2,  0, SCHED_BUDGET_RENDER  },
+    { taskHouse,   0, 10, SCHED_BUDGET_HOUSE   }
+};
+static unsigned long schedLast[STATS_NUM_TASKS];
+static uint8_t       schedOrder[STATS_NUM_TASKS];
+static uint8_t       schedDeferred[STATS_NUM_TASKS];
+
+/*
+ * Sort the tasks by priority (stable)
+ */
+static void schedSetup()
+{
+    for(int i = 0; i < STATS_NUM_TASKS; i++) {
+        int j = i;
+        while(j > 0 && schedTasks[schedOrder[j - 1]].prio < schedTasks[i].prio) {
+            schedOrder[j] = schedOrder[j - 1];
+            j--;
+        }
+        schedOrder[j] = i;
+    }
+}
+
 void dmx_loop()
 {
-    bool newDataDT = false;
-    bool newDataPT = false;
-    bool newDataLT = false;
+    unsigned long passStart, now;
+    uint32_t elapsed, bytes, trans, bytes0, trans0;
+    int32_t  over, worstOver = INT32_MIN;
+    int      worst = 0;
+
+    #ifdef TC_LEAN_RX
+    uint8_t *rxData;
+    int      rxErr;
+
+    if((rxSize = dmxrx_receive(&rxData, &rxErr, &rxBreak, rxWait))) {
+        packet.err = (dmx_err_t)rxErr;
+        packet.size = rxSize;
+        // The receiver's buffer holds the slots in use
+        if(!packet.err) data = rxData;
+    }
+    #else
+    rxSize = dmx_receive_num(dmxPort, &packet, dmx_slots_to_receive, rxWait);
+
+    // The driver does not tell when the break was; estimate it from
+    // the slots received since (for the latency statistics only, this
+    // includes the wait for the loop)
+    if(rxSize) {
+        rxBreak = esp_timer_get_time() - packet.size * DMX_SLOT_US - DMX_BREAK_US;
+    }
+    #endif
+
+    passStart = micros();
+    busTraffic(&bytes0, &trans0);
+
+    for(int o = 0; o < STATS_NUM_TASKS; o++) {
+        int i = schedOrder[o];
+        if(schedTasks[i].period && millis() - schedLast[i] < schedTasks[i].period)
+            continue;
+        if(schedTasks[i].prio < SCHED_PRIO_FRAME && schedDeferred[i] < SCHED_DEFER_MAX &&
+           micros() - passStart + schedTasks[i].budget > STATS_FRAME_US) {
+            schedDeferred[i]++;
+            continue;
+        }
+        schedDeferred[i] = 0;
+        if(schedTasks[i].period) schedLast[i] = millis();
+
+        now = micros();
+        schedTasks[i].run();
+        elapsed = micros() - now;
+
+        if(elapsed > stats.taskTimeMax[i]) stats.taskTimeMax[i] = elapsed;
+        over = (int32_t)(elapsed - schedTasks[i].budget);
+        if(over > 0) stats.taskOverruns[i]++;
+        if(over > worstOver) {
+            worstOver = over;
+            worst = i;
+        }
+    }
+
+    elapsed = micros() - passStart;
+    if(elapsed > stats.loopTimeMax) stats.loopTimeMax = elapsed;
+    if(elapsed > STATS_FRAME_US) {
+        stats.loopOverruns++;
+        stats.taskMisses[worst]++;
+    }
+
+    busTraffic(&bytes, &trans);
+    if((bytes -= bytes0)) {
+        trans -= trans0;
+        stats.i2cBytes = bytes;
+        stats.i2cTransactions = trans;
+        if(bytes > stats.i2cBytesMax) stats.i2cBytesMax = bytes;
+        if(trans > stats.i2cTransactionsMax) stats.i2cTransactionsMax = trans;
+        if(bytes > I2C_BUDGET_PASS) {
+            stats.i2cBudgetOverruns++;
+            log_event(LOG_I2C_BUDGET, bytes, I2C_BUDGET_PASS);
+        }
+    }
+}
+
+/*
+ * I2C traffic of all devices so far
+ */
+static void busTraffic(uint32_t *bytes, uint32_t *trans)
+{
+    uint32_t b = rtc.getBusBytes();
+    uint32_t t = rtc.getBusTransactions();
+
+    for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+        b += displays[i].getBusBytes();
+        t += displays[i].getBusTransactions();
+    }
+    #ifdef TC_HAVESPEEDO
+    b += speedo.getBusBytes();
+    t += speedo.getBusTransactions();
+    #endif
+
+    *bytes = b;
+    *trans = t;
+}
+
+/*
+ * Receive task: Read and decode the packet
+ */
+static void taskReceive()
+{
+    if(rxSize) {
 
-    if(dmx_receive_num(dmxPort, &packet, dmx_slots_to_receive, 0)) {
+        TRACE_BEGIN(TR_RECEIVE, rxSize);
         
         lastDMXpacket = millis();
     
         if(!packet.err) {
 
+            stats.frames++;
+
             if(!dmxIsConnected) {
-                Serial.println("DMX is connected");
+                log_event(LOG_DMX_CONNECTED);
                 dmxIsConnected = true;
             }
       
-            dmx_read(dmxPort, data, packet.size);
+            #ifndef TC_LEAN_RX
+            // Regular packets: Only the slots in use are read. Other
+            // start codes, and the SIP checksum, need the whole packet.
+            // (The lean receiver's buffer holds only the slots in use.)
+            dmx_read_offset(dmxPort, 0, data, 1);
+            if(!data[0] && !sipActive) {
+                readWindows(packet.size);
+            } else {
+                dmx_read(dmxPort, data, packet.size);
+            }
+            #endif
       
             if(!data[0]) {
 
+                checkPersonality();
+
+                if(persCur == PERS_RAW) {
+
+                    // Raw segments: Not verified, no scenes
+                    detectChanges();
+
+                    pendDisp |= setRawDisplays();
+
+                }
                 #ifdef DMX_USE_VERIFY
-                if(data[DMX_VERIFY_CHANNEL] == DMX_VERIFY_VALUE) {
+                else if(data[DMX_VERIFY_CHANNEL] == DMX_VERIFY_VALUE) {
+                #else
+                else {
                 #endif
-    
-                    if(memcmp(cachedt, data + DT_BASE, DMX_CHANNELS_PER_DISPLAY)) {
-                        setDisplay(&destinationTime, DT_BASE, 1);
-                        newDataDT = true;
-                        memcpy(cachedt, data + DT_BASE, DMX_CHANNELS_PER_DISPLAY);
-                    }
-                    if(memcmp(cachept, data + PT_BASE, DMX_CHANNELS_PER_DISPLAY)) {
-                        setDisplay(&presentTime, PT_BASE, 2);
-                        newDataPT = true;
-                        memcpy(cachept, data + PT_BASE, DMX_CHANNELS_PER_DISPLAY);
-                    }
-                    if(memcmp(cachelt, data + LT_BASE, DMX_CHANNELS_PER_DISPLAY)) {
-                        setDisplay(&departedTime, LT_BASE, 4);
-                        newDataLT = true;
-                        memcpy(cachelt, data + LT_BASE, DMX_CHANNELS_PER_DISPLAY);
+
+                    #ifdef TC_BLINK_LOCK
+                    blinkChannel();
+                    #endif
+
+                    #ifdef TC_HAVESCENES
+                    handleScenes();
+                    #endif
+
+                    if(sceneCur) {
+
+                        // Scene is shown; DMX data is not decoded
+
+                    } else if(userpers_active()) {
+
+                        detectChanges();
+
+                        pendDisp |= setUserDisplays(data + DMX_ADDRESS, &pendMode);
+
+                    } else {
+
+                        detectChanges();
+
+                        for(int p = 0; p < TC_NUM_PANELS; p++) {
+                            int md = modeChannel + p * panelSlots;
+                            int rt = rateChannel + p * panelSlots;
+
+                            if(slotsChanged(md - DMX_ADDRESS, DMX_MODE_CHANNELS)) {
+                                for(int i = 0; i < DMX_MODE_CHANNELS; i++) {
+                                    pendMode |= setDisplayMode(p * 3 + i, persDecodeGlobal<PG_MODE>(data[md + i]));
+                                }
+                            }
+
+                            if(slotsChanged(rt - DMX_ADDRESS, DMX_RATE_CHANNELS)) {
+                                for(int i = 0; i < DMX_RATE_CHANNELS; i++) {
+                                    frState[p * 3 + i].rate = frDecodeRate(data[rt + i]);
+                                }
+                            }
+                        }
+
+                        for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+                            int base = DISP_BASE(d);
+
+                            if((pendMode & (1 << d)) || slotsChanged(base - DMX_ADDRESS, dispSlots)) {
+                                setDisplay(&displays[d], d, base);
+                                pendDisp |= (1 << d);
+                                textHold &= ~(1 << d);
+                            }
+                        }
+
                     }
 
                     #ifdef TC_HAVESPEEDO
-                    if(useSpeedo) {
+                    if(useSpeedo && !sceneCur) {
                         if(memcmp(cachesp, data + SP_BASE, DMX_SPEEDO_CHANNELS)) {
-                            setSpeedoDisplay(&speedo, SP_BASE);
+                            pendSpeedo = true;
                             memcpy(cachesp, data + SP_BASE, DMX_SPEEDO_CHANNELS);
                         }
                     }
                     #endif
 
+                    #ifdef TC_SOFTDIM
+                    if(dimSteps && memcmp(cachedim, data + DMX_DIM_CHANNEL, DMX_DIM_CHANNELS)) {
+                        setFieldLevels();
+                        memcpy(cachedim, data + DMX_DIM_CHANNEL, DMX_DIM_CHANNELS);
+                    }
+                    #endif
+
                 #ifdef DMX_USE_VERIFY
                 } else {
 
-                    Serial.printf("Bad verification value on channel %d: %d (should be %d)\n", 
-                          DMX_VERIFY_CHANNEL, data[DMX_VERIFY_CHANNEL], DMX_VERIFY_VALUE);
+                    log_event(LOG_BAD_VERIFY, DMX_VERIFY_CHANNEL, data[DMX_VERIFY_CHANNEL]);
                   
-                }
                 #endif
+                }
+
+                // Checksum for verification through next SIP
+                if(sipActive) {
+                    lastChecksum = 0;
+                    for(int i = 1; i < (int)packet.size; i++) {
+                        lastChecksum += data[i];
+                    }
+                    lastSize = packet.size;
+                }
 
             } else {
-              
-                Serial.printf("Unrecognized start code %d (0x%02x)", data[0], data[0]);
+
+                pendDisp |= scHandlers[scIndex[data[0]]]((int)packet.size);
                 
             }
           
         } else {
             
-            Serial.printf("DMX error: %d\n", packet.err);
+            log_event(LOG_DMX_ERROR, packet.err);
+            stats.dmxErrors[min((int)packet.err, STATS_NUM_ERRTYPES - 1)]++;
             
         }
+
+        TRACE_END(TR_RECEIVE, rxSize);
         
     }
+}
 
+/*
+ * Blink task: Colons and cue list, on the edges of the 1Hz signal
+ */
+static void taskBlink()
+{
     y = digitalRead(SECONDS_IN_PIN);
     if(y != x) {
-        if(destinationTime.colonBlink) {
-            destinationTime.setColon(!y);
-            newDataDT = true;
-        }
-        if(presentTime.colonBlink) {
-            presentTime.setColon(!y);
-            newDataPT = true;
-        }
-        if(departedTime.colonBlink) {
-            departedTime.setColon(!y);
-            newDataLT = true;
+        TRACE_INSTANT(TR_SQW, y);
+        rtcUpdate = true;
+        #ifndef TC_BLINK_LOCK
+        for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+            if(displays[d].colonBlink) {
+                displays[d].setColon(!y);
+                pendDisp |= (1 << d);
+            }
         }
+        #endif
         x = y;
+
+        // Cue list: Once per second
+        if(!y && cuesActive) {
+            pendDisp |= checkCues();
+        }
     }
 
-    if(newDataDT) {
-        destinationTime.show();
-        if(destinationTime.isOn) destinationTime.on();
+    #ifdef TC_BLINK_LOCK
+    blinkColons();
+    #endif
+}
+
+/*
+ * Effects task: Displays in RTC and free-run mode
+ */
+static void taskEffects()
+{
+    // Displays in RTC mode are updated from the RTC on every
+    // edge of the 1Hz signal, or when switched to RTC mode.
+    // Only a change of minute causes a re-render.
+    if(rtcUpdate && !sceneCur) {
+        uint32_t rtcDisps = 0;
+        for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+            if(dispMode[d] == DM_RTC) rtcDisps |= (1 << d);
+        }
+        if(rtcDisps) {
+            DateTime dt;
+            rtc.now(dt);
+            if(dt.minute() != rtcLastMin || pendMode) {
+                for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+                    if(rtcDisps & (1 << d)) {
+                        setDisplayDateTime(&displays[d], dt.year(), dt.month(), dt.day(), dt.hour(), dt.minute());
+                    }
+                }
+                pendDisp |= rtcDisps;
+                rtcLastMin = dt.minute();
+            }
+        }
+        rtcUpdate = false;
     }
-    if(newDataPT) {
-        presentTime.show();
-        if(presentTime.isOn) presentTime.on();
+
+    // Free-running clocks are advanced by the timer ticks
+    // that occurred since the last run (and keep running
+    // while a scene is shown).
+    if(frTicks != frLastTicks) {
+        uint32_t ticks = frTicks - frLastTicks;
+        frLastTicks += ticks;
+        for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+            if(dispMode[d] == DM_FREERUN && frAdvance(d, ticks) && !sceneCur) {
+                frShow(&displays[d], d);
+                pendDisp |= (1 << d);
+            }
+        }
     }
-    if(newDataLT) {
-        departedTime.show();
-        if(departedTime.isOn) departedTime.on();
+
+    pendMode = 0;
+}
+
+/*
+ * Render task: Show what the other tasks changed
+ */
+static void taskRender()
+{
+    #ifdef TC_SOFTDIM
+    // PWM step: Displays whose fields were blanked or restored are
+    // written, too
+    dimOnly = dimStep() & ~(pendDisp | textHold);
+    #endif
+
+    // Displays showing text from text packets are not updated.
+    if(pendDisp || pendSpeedo) {
+        TRACE_BEGIN(TR_RENDER, pendDisp);
+        showDisplays((pendDisp & ~textHold) | dimOnly, pendSpeedo);
+        TRACE_END(TR_RENDER, pendDisp);
+        if(rxSize && !packet.err) {
+            updateLatency();
+        }
+    } else if(dimOnly) {
+        TRACE_BEGIN(TR_RENDER, dimOnly);
+        showDisplays(dimOnly, false);
+        TRACE_END(TR_RENDER, dimOnly);
     }
-    if(newDataDT || newDataPT || newDataLT) {
+    if(pendDisp) {
         if(kpleds) {
             digitalWrite(LEDS_PIN, HIGH);
         } else {
@@ -422,11 +1243,367 @@ void dmx_loop()
         }
     }
 
-    if(dmxIsConnected && (millis() - lastDMXpacket > 1250)) {
-        Serial.println("DMX was disconnected");
-        dmxIsConnected = false;
+    pendDisp = 0;
+    pendSpeedo = false;
+}
+
+/*
+ * Housekeeping task: Disconnect detection, statistics, warm state
+ */
+static void taskHouse()
+{
+    if(dmxIsConnected && (millis() - lastDMXpacket > 1250)) {
+        log_event(LOG_DMX_DISCONNECTED);
+        dmxIsConnected = false;
         invalidateCache();
     }
+
+    if(millis() - statsLastSecond >= 1000) {
+        updateStats();
+    }
+
+    if(warmDirty) {
+        warmSave();
+    }
+
+    #ifdef TC_HAVESCENES
+    if(scenePendNum) {
+        storeScene();
+    }
+    #endif
+
+    #ifdef TC_TRACE
+    trace_poll();
+    #endif
+}
+
+/*
+ * Show displays (bitmask by display index) and the speedo
+ *
+ * Displays are shown in index order, ie grouped by panel, so the
+ * multiplexer is switched at most once per panel. With TC_I2C_SPLIT,
+ * the displays on bus 1 are handed to the bus 1 task and shown
+ * while the ones on bus 0 are shown here. The DMX loop does not
+ * access bus 1 until the bus 1 task is done, so each bus is only
+ * used by one task at a time (see muxCur in clockdisplay.cpp).
+ */
+static void TC_IRAM showBus(int bus, uint32_t mask, bool spd)
+{
+    unsigned long now = micros();
+
+    for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+        if(mask & (1 << d)) showDisplay(&displays[d], d);
+    }
+
+    #ifdef TC_HAVESPEEDO
+    if(spd) showSpeedo();
+    #endif
+
+    busBusy[bus] += micros() - now;
+}
+
+static void showDisplays(uint32_t mask, bool spd)
+{
+    #ifdef TC_I2C_SPLIT
+    uint32_t mask1 = mask & bus1Disps;
+    bool     spd1 = spd && TC_BUS_SPEEDO;
+
+    if(mask1 || spd1) {
+        bus1Mask = mask1;
+        bus1Speedo = spd1;
+        bus1Caller = xTaskGetCurrentTaskHandle();
+        xTaskNotifyGive(bus1Task);
+        mask &= ~mask1;
+        spd = spd && !spd1;
+    }
+    #endif
+
+    showBus(0, mask, spd);
+
+    #ifdef TC_I2C_SPLIT
+    if(mask1 || spd1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    #endif
+}
+
+#ifdef TC_I2C_SPLIT
+static void bus1TaskFunc(void *parameter)
+{
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        showBus(1, bus1Mask, bus1Speedo);
+        xTaskNotifyGive(bus1Caller);
+    }
+}
+#endif
+
+static void TC_IRAM showDisplay(clockDisplay *display, int did)
+{
+    unsigned long now = micros();
+
+    display->showChanged();
+
+    // A PWM step only rewrites display RAM
+    if(!(dimOnly & (1 << did))) {
+        if(display->isOn) display->on();
+        warmDirty = true;
+    }
+
+    now = micros() - now;
+    stats.busTime[did % 3] = now;
+    if(now > stats.busTimeMax[did % 3]) stats.busTimeMax[did % 3] = now;
+}
+
+#ifdef TC_DMX_TASK
+/*
+ * DMX task: Runs the DMX loop, waiting for packets. Housekeeping
+ * (statistics, RTC temperature) is part of the loop, as it uses
+ * the bus and writes the statistics (see tc_stats.h).
+ */
+static void dmxTask(void *parameter)
+{
+    for(;;) {
+        dmx_loop();
+    }
+}
+
+void dmx_start_tasks()
+{
+    rxWait = pdMS_TO_TICKS(DMX_TASK_WAIT_MS);
+
+    #ifdef TC_SOFTDIM
+    // PWM steps are taken in the loop
+    if(dimSteps) rxWait = 1;
+    #endif
+
+    xTaskCreatePinnedToCore(dmxTask, "dmx", 8192, NULL, DMX_TASK_PRIO, NULL, DMX_TASK_CORE);
+}
+#endif
+
+/*
+ * Once per second: Update frame rate, uptime, error counts;
+ * RTC temperature once per minute.
+ */
+static void updateStats()
+{
+    uint32_t i2cErrors = rtc.getI2CErrors();
+
+    statsLastSecond = millis();
+
+    stats.fps = stats.frames - statsLastFrames;
+    statsLastFrames = stats.frames;
+
+    stats.uptime = statsLastSecond / 1000;
+
+    for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+        i2cErrors += displays[i].getI2CErrors();
+    }
+    #ifdef TC_HAVESPEEDO
+    i2cErrors += speedo.getI2CErrors();
+    #endif
+    stats.i2cErrors = i2cErrors;
+
+    for(int i = 0; i < STATS_NUM_BUSES; i++) {
+        stats.busUtil[i] = busBusy[i] / 100;    // 1/100 percent
+        busBusy[i] = 0;
+    }
+
+    #ifdef TC_LEAN_RX
+    {
+        uint32_t cyclesMax, cycles, mhz = ESP.getCpuFreqMHz();
+        dmxrx_isr_stats(&cyclesMax, &cycles);
+        stats.rxIsrMax = cyclesMax * 1000 / mhz;            // ns
+        stats.rxIsrLoad = cycles / (mhz * 100);             // 1/100 percent
+    }
+    #endif
+
+    #ifdef TC_BLINK_LOCK
+    // No RDM with the lean receiver: Report the phase error in the log
+    if(blLocked && !(stats.uptime % BLINK_REPORT_S)) {
+        log_event(LOG_BLINK_PHASE, stats.blinkPhaseErr, stats.blinkPhaseErrMax);
+    }
+    #endif
+
+    #ifdef TC_BENCH
+    // Receiver comparison (lean receiver vs esp_dmx); without
+    // TC_LEAN_RX, the driver's interrupt time is not known
+    if(!(stats.uptime % 10)) {
+        #ifdef TC_LEAN_RX
+        const char *rx = "lean";
+        #else
+        const char *rx = "esp_dmx";
+        #endif
+        Serial.printf("bench,rx,%s,%lu,%lu,%lu,%lu\n", rx,
+                      (unsigned long)stats.rxIsrMax, (unsigned long)stats.rxIsrLoad,
+                      (unsigned long)stats.rxLatency, (unsigned long)stats.rxLatencyMax);
+    }
+    #endif
+
+    if(haveRTC && !statsTempCount--) {
+        stats.rtcTemp = (int32_t)(rtc.getTemperature() * 100.0f);
+        statsTempCount = 59;
+    }
+}
+
+#ifdef TC_BLINK_LOCK
+/*
+ * Blink phase lock: A second (of timecode, or of the reference
+ * channel) started at tr (us), the time of the packet's break. The phase
+ * error is the time from the start of our blink to tr, modulo one
+ * second; it is corrected by a PI loop, the integral part following
+ * the drift between the RTC's oscillator and the controller's.
+ * All units receive the same packet, so they end up in phase.
+ */
+static void blinkReference(uint32_t tr)
+{
+    int32_t err = ((int32_t)(tr - blSqwFall) - blPhase) % BLINK_PERIOD_US;
+
+    if(err >= BLINK_PERIOD_US / 2) err -= BLINK_PERIOD_US;
+    else if(err < -BLINK_PERIOD_US / 2) err += BLINK_PERIOD_US;
+
+    if(abs(err) > BLINK_JUMP_US) {
+        blPhase += err;
+        blFreq = 0;
+    } else {
+        blFreq += err / BLINK_KI;
+        blPhase += err / BLINK_KP + blFreq;
+    }
+    blPhase %= BLINK_PERIOD_US;
+    if(blPhase < 0) blPhase += BLINK_PERIOD_US;
+
+    if(!blLocked) {
+        log_event(LOG_BLINK_LOCKED, err);
+        blLocked = true;
+    }
+    blLastRef = millis();
+
+    stats.blinkPhaseErr = err;
+    if((uint32_t)abs(err) > stats.blinkPhaseErrMax) stats.blinkPhaseErrMax = abs(err);
+    stats.blinkLocked = 1;
+}
+
+/*
+ * Reference channel: A rising edge starts a second
+ */
+static void blinkChannel()
+{
+    uint8_t val = data[DMX_BLINK_CHANNEL];
+
+    if(blChanPrev >= 0 && blChanPrev < 128 && val >= 128) {
+        blinkReference((uint32_t)rxBreak);
+    }
+    blChanPrev = val;
+}
+
+/*
+ * Set the colons of blinking displays from the locked phase. Without
+ * timecode, the last phase is held.
+ */
+static void blinkColons()
+{
+    int32_t t;
+    bool    on;
+
+    if(blLocked && millis() - blLastRef > BLINK_TIMEOUT_MS) {
+        log_event(LOG_BLINK_LOST);
+        blLocked = false;
+        stats.blinkLocked = 0;
+    }
+
+    t = ((int32_t)(micros() - blSqwFall) - blPhase) % BLINK_PERIOD_US;
+    if(t < 0) t += BLINK_PERIOD_US;
+    on = (t < BLINK_PERIOD_US / 2);
+
+    if(on != blColon) {
+        for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+            if(displays[d].colonBlink) {
+                displays[d].setColon(on);
+                pendDisp |= (1 << d);
+            }
+        }
+        blColon = on;
+    }
+}
+#endif
+
+#ifdef TC_SOFTDIM
+/*
+ * Software dimming: Bus budget. In the worst case, a PWM step
+ * rewrites all columns of every display on the busier bus, plus a
+ * multiplexer switch per panel. The step period is that time plus a
+ * margin; the number of steps per PWM period is the largest that
+ * keeps the PWM frequency at DIM_MIN_HZ or above. Returns the step
+ * period (us); with less than 2 steps, there is no dimming.
+ */
+uint32_t dmx_dim_budget(uint32_t clock, int *steps)
+{
+    int      disps = TC_NUM_DISPLAYS;
+    uint32_t us;
+
+    #ifdef TC_I2C_SPLIT
+    disps = max(TC_BUS_DEST + TC_BUS_PRES + TC_BUS_LAST,
+                3 - (TC_BUS_DEST + TC_BUS_PRES + TC_BUS_LAST)) * TC_NUM_PANELS;
+    #endif
+
+    us = disps * ((2 + DIM_STEP_BYTES * 9) * 1000000 / clock + DIM_GAP_US);
+    #if TC_NUM_PANELS > 1
+    us += TC_NUM_PANELS * ((2 + DIM_MUX_BYTES * 9) * 1000000 / clock + DIM_GAP_US);
+    #endif
+    us = us * (100 + DIM_MARGIN_PCT) / 100;
+    if(us < DIM_STEP_MIN_US) us = DIM_STEP_MIN_US;
+
+    *steps = (int)min(1000000 / (us * DIM_MIN_HZ), (uint32_t)DIM_STEPS_MAX);
+
+    return us;
+}
+
+/*
+ * Software dimming: Field levels from the dim channels
+ */
+static void setFieldLevels()
+{
+      const uint8_t *src = data + DMX_DIM_CHANNEL;
+
+      for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+          for(int f = 0; f < CDF_NUM; f++, src++) {
+              displays[d].setFieldLevel(f, *src ? ((*src - 1) * dimSteps + 127) / 254 : 255);
+          }
+      }
+}
+
+/*
+ * Software dimming: Enter the PWM step of the timer's tick; returns
+ * the displays whose fields were blanked or restored. Ticks missed
+ * while the loop was busy are skipped.
+ */
+static uint32_t dimStep()
+{
+    uint32_t ticks = dimTicks;
+    uint32_t mask = 0;
+
+    if(!dimSteps || ticks == dimLastTicks)
+        return 0;
+
+    dimLastTicks = ticks;
+
+    for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+        if(displays[d].setDimStep(ticks % dimSteps)) mask |= (1 << d);
+    }
+
+    return mask;
+}
+#endif
+
+/*
+ * Time from a packet's break until the displays are updated
+ */
+static void updateLatency()
+{
+    uint32_t lat = (uint32_t)(esp_timer_get_time() - rxBreak);
+
+    stats.rxLatency = lat;
+    if(lat > stats.rxLatencyMax) stats.rxLatencyMax = lat;
 }
 
 
@@ -438,76 +1615,666 @@ void dmx_loop()
  *********************************************************************************/
 
 /*
- * 0 = ch1  - Sets the month
- * 1 = ch2  - Sets the day
- * 2 = ch3  - Sets 1000’s digit for year
- * 3 = ch4  - Sets 100’s digit for year
- * 4 = ch5  - Sets 10’s digit for year
- * 5 = ch6  - Sets 1’s digit for year
- * 6 = ch7  - Sets Hour 1-12
- * 7 = ch8  - Sets Minute 00-59
- * 8 = ch9  - Sets AM/PM (0-127=AM, 128-255=PM)
- * 9 = ch10 - colon      (0-85=off; 86-170=on; >=171 blink) 
- * 10 = ch11 - Master Intensity (0-255)
+ * Channel layout and value ranges: See tc_personality.h
  * 
  * Keypad LEDs are off if all displays' Intensity is 0
  * otherwise on
  */
 
-static void setDisplay(clockDisplay *display, int base, int kpbit)
+static void TC_IRAM setDisplay(clockDisplay *display, int did, int base)
 {
-      int mbri;
+      uint8_t val[PF_NUM];
 
       #ifdef TC_DBG
-      for(int i = 0; i < 11; i++) {
-          Serial.printf("%02x ", data[base + i]);
+      log_event_data(LOG_DISP_DATA + did % 3, data + base, dispSlots, did / 3);
+      #endif
+
+      if(persCur == PERS_16BIT) {
+          persDecode16(data + base, val);
+      } else {
+          persDecode(data + base, val);
       }
-      Serial.println(" ");
+
+      applyDisplay(display, did, val);
+}
+
+#ifndef TC_LEAN_RX
+/*
+ * Read the slots in use from the driver's buffer: The panels'
+ * window, and the speedo, scene and verify channels. Other slots
+ * of data[] keep stale values.
+ */
+static void readWindow(int first, int num, int size)
+{
+      if(first + num > size) num = size - first;
+
+      if(num > 0) {
+          dmx_read_offset(dmxPort, first, data + first, num);
+      }
+}
+
+static void readWindows(int size)
+{
+      readWindow(DMX_ADDRESS, winSlots, size);
+      #ifdef TC_HAVESPEEDO
+      if(useSpeedo) readWindow(SP_BASE, DMX_SPEEDO_CHANNELS, size);
       #endif
+      #ifdef TC_HAVESCENES
+      readWindow(DMX_SCENE_CHANNEL, DMX_SCENE_CHANNELS, size);
+      #endif
+      #ifdef TC_SOFTDIM
+      readWindow(DMX_DIM_CHANNEL, DMX_DIM_CHANNELS, size);
+      #endif
+      #ifdef DMX_USE_VERIFY
+      readWindow(DMX_VERIFY_CHANNEL, 1, size);
+      #endif
+}
+#endif
+
+/*
+ * Compare the panels' window with the previous frame, a word (four
+ * slots) at a time, and collect the changed slots in slotChg.
+ */
+static void TC_IRAM detectChanges()
+{
+      const uint32_t *win = (const uint32_t *)(data + DMX_ADDRESS);
+      int words = (winSlots + 3) / 4;
+
+      if(winForce) {
+          memcpy(winPrev, win, words * 4);
+          memset(slotChg, 0xff, sizeof(slotChg));
+          winForce = false;
+          return;
+      }
+
+      memset(slotChg, 0, sizeof(slotChg));
+
+      for(int i = 0; i < words; i++) {
+          uint32_t x = win[i] ^ winPrev[i];
+          if(x) {
+              // Little endian: Byte n is slot i * 4 + n
+              uint32_t bits = ((x & 0x000000ff) ? 1 : 0) | ((x & 0x0000ff00) ? 2 : 0) |
+                              ((x & 0x00ff0000) ? 4 : 0) | ((x & 0xff000000) ? 8 : 0);
+              slotChg[i >> 3] |= bits << ((i & 7) * 4);
+              winPrev[i] = win[i];
+          }
+      }
+}
+
+// Did any of the given slots (relative to DMX_ADDRESS) change?
+static bool TC_IRAM slotsChanged(int first, int num)
+{
+      while(num > 0) {
+          int b = first & 31;
+          int n = min(num, 32 - b);
+          uint32_t m = (n == 32) ? 0xffffffff : ((1UL << n) - 1) << b;
 
-      display->setMonth(monthRanges[data[base + 0]]);
+          if(slotChg[first >> 5] & m)
+              return true;
 
-      display->setDay(data[base + 1] / 8);
+          first += n;
+          num -= n;
+      }
+
+      return false;
+}
+
+/*
+ * Set up a display from its decoded channel values, 
+ * including brightness
+ */
+static void TC_IRAM applyDisplay(clockDisplay *display, int did, const uint8_t *val)
+{
+      uint32_t kpbit = 1 << did;
+      unsigned long now = micros();
+
+      TRACE_BEGIN(TR_DECODE, did);
+      decodeDisplay(display, did, val);
+      TRACE_END(TR_DECODE, did);
 
-      display->setYearDigits(yearRanges[data[base + 2]], yearRanges[data[base + 3]],
-                             yearRanges[data[base + 4]], yearRanges[data[base + 5]]);
+      now = micros() - now;
+      stats.decodeTime[did % 3] = now;
+      if(now > stats.decodeTimeMax[did % 3]) stats.decodeTimeMax[did % 3] = now;
 
-      display->setHour12(hourRanges[data[base + 6]]);
+      if(val[PF_BRIGHTNESS]) {
+          display->setBrightness(val[PF_BRIGHTNESS] - 1);
+          display->isOn = true;     // off immediately, on after show in loop()
+          kpleds |= kpbit;
+      } else {
+          display->off();           // off immediately, on after show in loop()
+          display->isOn = false;
+          kpleds &= ~kpbit;
+      }
+}
+
+/*
+ * Set up a display from its decoded channel values
+ * (no bus access)
+ */
+static void TC_IRAM decodeDisplay(clockDisplay *display, int did, const uint8_t *val)
+{
+      int mode = dispMode[did];
+
+      if(mode == DM_DMX || mode == DM_TIMECODE) {
+
+          display->setMonth(val[PF_MONTH]);
+
+          display->setDay(val[PF_DAY]);
+
+          display->setYearDigits(val[PF_YEAR1000], val[PF_YEAR100],
+                                 val[PF_YEAR10], val[PF_YEAR1]);
+
+          display->setHour12(val[PF_HOUR]);
       
-      display->setMinute(minRanges[data[base + 7]]);
+          display->setMinute(val[PF_MINUTE]);
 
-      #if 0
-      if(data[base + 8] <= 85)        display->setAMPM(-1); // off
-      else if(data[base + 8] <= 170)  display->setAMPM(1);  // PM  
-      else                            display->setAMPM(0);  // AM
-      #else
-      if(data[base + 8] <= 127) display->setAMPM(1);  // PM
-      else                      display->setAMPM(0);  // AM  
-      // no off?                display->setAMPM(-1); // off
-      #endif
+          display->setAMPM(val[PF_AMPM] ? 0 : 1);
+
+          if(mode == DM_TIMECODE && tcValid) {
+              setDisplayTime(display, tcHour, tcMinute);
+          }
+
+      } else if(mode == DM_FREERUN) {
+
+          if(frState[did].reseed || memcmp(frState[did].seed, val, PF_DATETIME_NUM)) {
+              int d, hour;
+
+              d = val[PF_MONTH];
+              frState[did].month = d ? d : 1;
+              d = val[PF_DAY];
+              frState[did].day = d ? d : 1;
+              frState[did].year = 0;
+              for(int i = PF_YEAR1000; i <= PF_YEAR1; i++) {
+                  d = val[i];
+                  frState[did].year = frState[did].year * 10 + (d ? d - 1 : 0);
+              }
+              d = val[PF_HOUR];
+              hour = (d ? d - 1 : 0) % 12;
+              if(!val[PF_AMPM]) hour += 12;   // PM
+              frState[did].hour = hour;
+              d = val[PF_MINUTE];
+              frState[did].minute = d ? min(d - 1, 59) : 0;
+              frState[did].accum = 0;
 
-      if(data[base + 9] <= 85) {
+              // Fix up day for this month
+              frAdvance(did, 0);
+
+              memcpy(frState[did].seed, val, PF_DATETIME_NUM);
+              frState[did].reseed = false;
+          }
+
+          frShow(display, did);
+
+      }
+
+      switch(val[PF_COLON]) {
+      case 0:
           display->setColon(false);
           display->colonBlink = false;
-      } else if(data[base + 9] <= 170) {
+          break;
+      case 1:
           display->setColon(true);
           display->colonBlink = false;
-      } else {
+          break;
+      default:
           display->colonBlink = true;
       }
+}
 
-      mbri = data[base + 10];   // Brightness: 0=off; 1-255:darkest->brightest
+/*
+ * Set a display's mode
+ * Returns display's bit if mode changed
+ */
+static uint32_t setDisplayMode(int did, int mode)
+{
+      if(mode >= DM_NUM || (mode == DM_RTC && !haveRTC)) {
+          mode = DM_DMX;
+      }
 
-      if(mbri) {
-          mbri /= 16; 
-          display->setBrightness(mbri);
-          display->isOn = true;     // off immediately, on after show in loop()
-          kpleds |= kpbit;
+      if(mode == dispMode[did])
+          return 0;
+
+      dispMode[did] = mode;
+      if(mode == DM_RTC) rtcUpdate = true;
+      if(mode == DM_FREERUN) frState[did].reseed = true;
+
+      return 1 << did;
+}
+
+/*
+ * User personality: Decode all displays' channels through the
+ * user's mapping program (once per panel), set up changed displays.
+ * Returns bitmask of displays to show
+ */
+static uint32_t setUserDisplays(const uint8_t *src, uint32_t *modeChg)
+{
+      uint8_t val[TC_NUM_DISPLAYS][UP_FIELDS];
+      uint32_t shw = 0;
+      int fp = userpers_footprint();
+
+      // Panels without changed slots decode to what they did before
+      for(int p = 0; p < TC_NUM_PANELS; p++) {
+          if((p + 1) * fp <= winSlots && slotsChanged(p * fp, fp)) {
+              userpers_run(src + p * fp, val[p * PERS_NUM_DISPLAYS]);
+          } else {
+              memcpy(val[p * PERS_NUM_DISPLAYS], cacheuser[p * PERS_NUM_DISPLAYS], sizeof(val[0]) * PERS_NUM_DISPLAYS);
+          }
+      }
+
+      for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+          if(val[i][PF_MODE] != cacheuser[i][PF_MODE]) {
+              *modeChg |= setDisplayMode(i, val[i][PF_MODE]);
+          }
+          if(val[i][PF_RATE] != cacheuser[i][PF_RATE]) {
+              frState[i].rate = frDecodeRate(val[i][PF_RATE]);
+          }
+          if((*modeChg & (1 << i)) || memcmp(cacheuser[i], val[i], PF_NUM)) {
+              applyDisplay(&displays[i], i, val[i]);
+              shw |= (1 << i);
+              textHold &= ~(1 << i);
+          }
+          memcpy(cacheuser[i], val[i], UP_FIELDS);
+      }
+
+      return shw;
+}
+
+/*
+ * Raw segment personality: Copy changed displays' slots into their
+ * display buffers as they are. Returns bitmask of displays to show
+ */
+static uint32_t setRawDisplays()
+{
+      uint32_t shw = 0;
+
+      for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+          int base = DISP_BASE(d);
+
+          if(slotsChanged(base - DMX_ADDRESS, dispSlots)) {
+              displays[d].setRaw(data + base);
+              shw |= (1 << d);
+              textHold &= ~(1 << d);
+          }
+      }
+
+      #ifdef TC_HAVESPEEDO
+      if(useSpeedo && slotsChanged(DMX_RAW_SPEEDO_CHANNEL - DMX_ADDRESS, DMX_RAW_SPEEDO_SLOTS)) {
+          speedo.setRaw(data + DMX_RAW_SPEEDO_CHANNEL);
+          pendSpeedo = true;
+      }
+      #endif
+
+      return shw;
+}
+
+/*
+ * Follow the personality selected through RDM
+ * (user personality has only one)
+ */
+static void checkPersonality()
+{
+      #ifdef TC_LEAN_RX
+      int p = PERS_STANDARD;      // No RDM
+      #else
+      int p = dmx_get_current_personality(dmxPort) - 1;
+      #endif
+
+      if(p < 0 || p >= PERS_NUM || userpers_active()) {
+          p = PERS_STANDARD;
+      }
+
+      if(p == persCur)
+          return;
+
+      if(p == PERS_RAW) {
+          // Displays show what they are sent, nothing else
+          for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+              setDisplayMode(d, DM_DMX);
+              displays[d].colonBlink = false;
+              displays[d].rawMode = true;
+              displays[d].isOn = true;
+              #ifdef TC_SOFTDIM
+              for(int f = 0; f < CDF_NUM; f++) {
+                  displays[d].setFieldLevel(f, 255);
+              }
+              #endif
+          }
+          textHold = 0;
+          sceneCur = 0;
+          winSlots = min(DMX_RAW_SLOTS, DMX_WIN_MAX);
+          #ifdef TC_HAVESPEEDO
+          if(useSpeedo) speedo.on();
+          #endif
+      } else if(persCur == PERS_RAW) {
+          for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+              displays[d].rawMode = false;
+          }
+          winSlots = TC_NUM_PANELS * DMX_FOOTPRINT;
+      }
+
+      // Wait only for the slots this personality uses (read by the
+      // driver on each receive, so this takes effect with the next
+      // packet)
+      dmx_slots_to_receive = (p == PERS_RAW) ? max(slotsBase, DMX_SLOTS_TO_RECEIVE_RAW) : slotsBase;
+
+      persCur = p;
+      dispSlots = persPersonalities[p].numFields;
+      panelSlots = persFootprint(p);
+      modeChannel = DMX_ADDRESS + persGlobalSlot(p, PG_MODE, 0);
+      rateChannel = DMX_ADDRESS + persGlobalSlot(p, PG_RATE, 0);
+
+      invalidateCache();
+
+      Serial.printf("DMX personality: %s\n", persPersonalities[p].desc);
+}
+
+#ifdef TC_BENCH
+void dmx_bench_decode(clockDisplay *display, const uint8_t *src, int pers)
+{
+      uint8_t val[PF_NUM];
+
+      if(pers == PERS_16BIT) {
+          persDecode16(src, val);
       } else {
-          display->off();           // off immediately, on after show in loop()
-          display->isOn = false;
-          kpleds &= ~kpbit;
+          persDecode(src, val);
       }
+      decodeDisplay(display, DISP_DEST, val);
+}
+#endif
+
+/*
+ * Set display from date/time (hour 0-23)
+ *
+ * setHour12() and setMinute() take the DMX-decoded
+ * values, where 0 means "blank".
+ */
+static void setDisplayDateTime(clockDisplay *display, int year, int month, int day, int hour, int minute)
+{
+      display->setYear(year);
+      display->setMonth(month);
+      display->setDay(day);
+      setDisplayTime(display, hour, minute);
+}
+
+static void setDisplayTime(clockDisplay *display, int hour, int minute)
+{
+      int hour12 = hour % 12;
+
+      display->setHour12((hour12 ? hour12 : 12) + 1);
+      display->setMinute(minute + 1);
+      display->setAMPM(hour >= 12 ? 1 : 0);
+}
+
+
+/*********************************************************************************
+ * 
+ * Free-running clock engine
+ *
+ *********************************************************************************/
+
+static bool isLeapYear(int year)
+{
+    return (!(year % 4) && (year % 100)) || !(year % 400);
+}
+
+static int daysInMonth(int month, int year)
+{
+    if(month == 2 && isLeapYear(year)) {
+        return 29;
+    }
+    return monthDays[month - 1];
+}
+
+/*
+ * Rate channel: 128-255 = x1 to x3600 forward, 127-0 = x1 to x3600
+ * reverse, logarithmic.
+ */
+static int frDecodeRate(uint8_t val)
+{
+    int i = (val >= 128) ? val - 128 : 127 - val;
+    int rate = (int)(powf(3600.0f, (float)i / 127.0f) + 0.5f);
+
+    return (val >= 128) ? rate : -rate;
+}
+
+/*
+ * Advance the clock by the given number of timer ticks.
+ * Returns true if the minute changed.
+ */
+static bool frAdvance(int did, uint32_t ticks)
+{
+    int year   = frState[did].year;
+    int month  = frState[did].month;
+    int day    = frState[did].day;
+    int hour   = frState[did].hour;
+    int minute = frState[did].minute;
+    bool changed = false;
+
+    frState[did].accum += frState[did].rate * (int32_t)(ticks * FR_TICK_MS);
+
+    while(frState[did].accum >= 60000) {
+        frState[did].accum -= 60000;
+        changed = true;
+        if(++minute > 59) {
+            minute = 0;
+            if(++hour > 23) {
+                hour = 0;
+                if(++day > daysInMonth(month, year)) {
+                    day = 1;
+                    if(++month > 12) {
+                        month = 1;
+                        if(++year > 9999) year = 0;
+                    }
+                }
+            }
+        }
+    }
+
+    while(frState[did].accum < 0) {
+        frState[did].accum += 60000;
+        changed = true;
+        if(--minute < 0) {
+            minute = 59;
+            if(--hour < 0) {
+                hour = 23;
+                if(--day < 1) {
+                    if(--month < 1) {
+                        month = 12;
+                        if(--year < 0) year = 9999;
+                    }
+                    day = daysInMonth(month, year);
+                }
+            }
+        }
+    }
+
+    // Seeds from DMX might be beyond the month's end
+    if(day > daysInMonth(month, year)) {
+        day = daysInMonth(month, year);
+    }
+
+    frState[did].year   = year;
+    frState[did].month  = month;
+    frState[did].day    = day;
+    frState[did].hour   = hour;
+    frState[did].minute = minute;
+
+    return changed;
+}
+
+static void frShow(clockDisplay *display, int did)
+{
+    setDisplayDateTime(display, frState[did].year, frState[did].month, 
+                       frState[did].day, frState[did].hour, frState[did].minute);
+}
+
+/*
+ * Cue list
+ *
+ * Cues are checked once per second, and only run while there is
+ * no DMX signal; DMX data takes over once the signal is back.
+ * The RTC is read to detect time changes; otherwise, the next
+ * cue is already known.
+ */
+static uint32_t runCue(const cueEntry *c)
+{
+      uint32_t shw = 0;
+
+      log_event(LOG_CUE, c->time, c->action);
+
+      if(c->action == CA_SCENE) {
+          #ifdef TC_HAVESCENES
+          const sceneData *sd = scenes_get(c->param);
+          if(sd) {
+              recallScene(sd);
+              sceneCur = c->param;
+          }
+          #endif
+          return 0;
+      }
+
+      sceneCur = 0;
+
+      // Cues address displays by ID, on all panels
+      for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+          if(!(c->displays & (1 << (i % 3))))
+              continue;
+
+          switch(c->action) {
+          case CA_DATE:
+              setDisplayMode(i, DM_DMX);
+              setDisplayDateTime(&displays[i], c->date.year, c->date.month, c->date.day,
+                                 c->date.hour, c->date.minute);
+              break;
+          case CA_RUN:
+              setDisplayMode(i, DM_FREERUN);
+              frState[i].year = c->date.year;
+              frState[i].month = c->date.month;
+              frState[i].day = c->date.day;
+              frState[i].hour = c->date.hour;
+              frState[i].minute = c->date.minute;
+              frState[i].accum = 0;
+              frState[i].rate = frDecodeRate(c->param);
+              frState[i].reseed = false;
+              frAdvance(i, 0);
+              frShow(&displays[i], i);
+              break;
+          case CA_RTC:
+              setDisplayMode(i, DM_RTC);
+              rtcLastMin = 255;
+              break;
+          case CA_BRIGHT:
+              if(c->param) {
+                  displays[i].setBrightness(c->param - 1);
+                  displays[i].isOn = true;
+                  kpleds |= (1 << i);
+              } else {
+                  displays[i].off();
+                  displays[i].isOn = false;
+                  kpleds &= ~(1 << i);
+              }
+              break;
+          }
+
+          textHold &= ~(1 << i);
+          shw |= (1 << i);
+      }
+
+      return shw;
+}
+
+static uint32_t checkCues()
+{
+      const cueEntry *c;
+      DateTime dt;
+      uint32_t sec, shw = 0;
+      int num;
+
+      rtc.now(dt);
+      sec = ((uint32_t)dt.hour() * 60 + dt.minute()) * 60 + dt.second();
+
+      if(!cueSynced || sec != (cueLastSec + 1) % CUE_SECS_PER_DAY) {
+          cues_sync(sec);
+          cueSynced = true;
+      }
+      cueLastSec = sec;
+
+      num = cues_due(sec, &c);
+
+      if(dmxIsConnected)
+          return 0;
+
+      while(num--) {
+          shw |= runCue(c++);
+      }
+
+      return shw;
+}
+
+/*
+ * Warm restart
+ *
+ * The rendered state is saved after every display update; that is
+ * a copy to RTC memory, no bus access. Display modes and the
+ * free-running clocks are not saved; the next DMX frame (which is
+ * fully decoded after boot) restores them.
+ */
+static uint32_t warmChecksum()
+{
+    const uint8_t *p = (const uint8_t *)&warmState;
+    uint32_t hash = 2166136261UL;   // FNV-1a
+
+    for(size_t i = 0; i < offsetof(warmState_t, checksum); i++) {
+        hash = (hash ^ p[i]) * 16777619UL;
+    }
+
+    return hash;
+}
+
+static void warmSave()
+{
+    memset(&warmState, 0, sizeof(warmState));
+
+    warmState.magic = WS_MAGIC;
+    warmState.size = sizeof(warmState);
+    warmState.kpleds = kpleds;
+    for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+        displays[i].getImage(&warmState.disp[i]);
+    }
+    #ifdef TC_HAVESPEEDO
+    if(useSpeedo) speedo.getImage(&warmState.speedo);
+    #endif
+    warmState.checksum = warmChecksum();
+
+    warmDirty = false;
+}
+
+static bool warmRestore()
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+
+    if(reason == ESP_RST_POWERON || reason == ESP_RST_UNKNOWN ||
+       warmState.magic != WS_MAGIC || warmState.size != sizeof(warmState) ||
+       warmState.checksum != warmChecksum()) {
+        warmState.magic = 0;
+        return false;
+    }
+
+    for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+        displays[i].setImage(&warmState.disp[i]);
+        displays[i].show();
+        if(displays[i].isOn) {
+            displays[i].on();
+        } else {
+            displays[i].off();
+        }
+    }
+
+    kpleds = warmState.kpleds;
+
+    Serial.printf("Warm restart (reset reason %d), display state restored\n", (int)reason);
+
+    return true;
 }
 
 /*
@@ -516,6 +2283,22 @@ static void setDisplay(clockDisplay *display, int base, int kpbit)
  * 1 = ch2 - Master Intensity (0-255; 0=off; 1-255 = darkest-brightest)
  */
 #ifdef TC_HAVESPEEDO
+static void showSpeedo()
+{
+      unsigned long now = micros();
+
+      if(persCur == PERS_RAW) {
+          speedo.showRaw();
+      } else {
+          setSpeedoDisplay(&speedo, SP_BASE);
+      }
+      warmDirty = true;
+
+      now = micros() - now;
+      stats.busTime[3] = now;
+      if(now > stats.busTimeMax[3]) stats.busTimeMax[3] = now;
+}
+
 static void setSpeedoDisplay(speedDisplay *display, int base)
 {
       int mbri = data[base + 1];   // Brightness: 0=off; 1-255:darkest->brightest
@@ -530,3 +2313,291 @@ static void setSpeedoDisplay(speedDisplay *display, int base)
       }
 }
 #endif
+
+#ifdef TC_HAVESCENES
+/*
+ * Scene channels (both: 0-7 = none, 8-15 = scene 1, 16-23 = scene 2,
+ * ..., 128-135 = scene 16; higher values = none)
+ *
+ * Select: Shows the scene instead of the DMX data; selecting an 
+ * empty scene or none returns to DMX data.
+ * Capture: Stores the displays' current state in the scene once the
+ * value was held for DMX_SCENE_CAPTURE_FRAMES frames. Only a change of
+ * the value arms a capture; a value already present in the first frame
+ * (eg at power-up) is ignored.
+ */
+static int sceneNum(uint8_t val)
+{
+      int scene = val / DMX_SCENE_BAND;
+
+      return (scene > SCENE_NUM) ? 0 : scene;
+}
+
+/*
+ * Capture: Take a copy of the images; writing to NVS takes too long
+ * for the receive path and is left to taskHouse
+ */
+static void captureScene(int scene)
+{
+      memset(&scenePend, 0, sizeof(scenePend));
+
+      for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+          displays[i].getImage(&scenePend.disp[i]);
+      }
+      #ifdef TC_HAVESPEEDO
+      if(useSpeedo) speedo.getImage(&scenePend.speedo);
+      #endif
+
+      scenePendNum = scene;
+}
+
+static void storeScene()
+{
+      scenes_put(scenePendNum, &scenePend);
+
+      log_event(LOG_SCENE_CAPTURE, scenePendNum);
+
+      scenePendNum = 0;
+}
+
+/*
+ * Recall: Straight copy to the displays, no decoding
+ */
+static void recallScene(const sceneData *sd)
+{
+      kpleds = 0;
+
+      for(int i = 0; i < TC_NUM_DISPLAYS; i++) {
+          unsigned long now = micros();
+
+          displays[i].setImage(&sd->disp[i]);
+          displays[i].show();
+          if(displays[i].isOn) {
+              displays[i].on();
+              kpleds |= (1 << i);
+          } else {
+              displays[i].off();
+          }
+
+          now = micros() - now;
+          stats.busTime[i % 3] = now;
+          if(now > stats.busTimeMax[i % 3]) stats.busTimeMax[i % 3] = now;
+      }
+
+      #ifdef TC_HAVESPEEDO
+      if(useSpeedo) speedo.setImage(&sd->speedo);
+      #endif
+
+      digitalWrite(LEDS_PIN, kpleds ? HIGH : LOW);
+
+      textHold = 0;
+
+      warmDirty = true;
+}
+
+static void handleScenes()
+{
+      bool first = !sceneSeen;
+      int  scene;
+
+      sceneSeen = true;
+
+      if(!memcmp(cachesc, data + DMX_SCENE_CHANNEL, DMX_SCENE_CHANNELS)) {
+          if(sceneCapture && sceneCaptureCnt < DMX_SCENE_CAPTURE_FRAMES) {
+              if(++sceneCaptureCnt == DMX_SCENE_CAPTURE_FRAMES) {
+                  captureScene(sceneCapture);
+              }
+          }
+          return;
+      }
+
+      scene = sceneNum(data[DMX_SCENE_CHANNEL + 1]);
+      if(scene != sceneCapture) {
+          sceneCapture = scene;
+          // Not an edge in the first frame: Not armed
+          sceneCaptureCnt = first ? DMX_SCENE_CAPTURE_FRAMES : 0;
+      }
+
+      scene = sceneNum(data[DMX_SCENE_CHANNEL]);
+      if(scene && !scenes_get(scene)) scene = 0;
+
+      memcpy(cachesc, data + DMX_SCENE_CHANNEL, DMX_SCENE_CHANNELS);
+
+      if(scene == sceneCur)
+          return;
+
+      sceneCur = scene;
+
+      log_event(LOG_SCENE_RECALL, scene);
+
+      if(scene) {
+          recallScene(scenes_get(scene));
+      } else {
+          // Back to DMX data: Re-decode everything
+          invalidateCache();
+          rtcUpdate = true;
+      }
+}
+#endif
+
+
+/*********************************************************************************
+ * 
+ * Alternate start codes
+ *
+ * Only the first dmx_slots_to_receive slots of any packet are read; this
+ * is enough for all packets handled below.
+ *
+ *********************************************************************************/
+
+static int scUnknown(int size)
+{
+    log_event(LOG_UNKNOWN_SC, data[0], data[0]);
+
+    return 0;
+}
+
+/*
+ * Text packet (0x17)
+ * 1 = Page: 0 = Destination, 1 = Present, 2 = Last Time Departed;
+ *     3-5 = second panel, etc.
+ * 2 = Characters per line (ignored)
+ * 3.. = ASCII text, NUL-terminated
+ *
+ * The text is shown until the display's DMX channels change, or
+ * an empty text is sent for the display.
+ */
+static int scText(int size)
+{
+    char text[DISP_LEN + 1];
+    int page, i;
+
+    if(size < 4 || (page = data[1]) >= TC_NUM_DISPLAYS)
+        return 0;
+
+    for(i = 0; i < DISP_LEN && i + 3 < size && data[i + 3]; i++) {
+        text[i] = data[i + 3];
+    }
+    text[i] = 0;
+
+    if(!i) {
+        if(textHold & (1 << page)) {
+            textHold &= ~(1 << page);
+            return (1 << page);
+        }
+        return 0;
+    }
+
+    displays[page].showTextDirect(text);
+    textHold |= (1 << page);
+
+    return 0;
+}
+
+/*
+ * System Information Packet (0xCF)
+ * 1 = SIP byte count
+ * 2 = Control bit field
+ * 3/4 = Checksum of previous packet
+ * 5 = SIP sequence number
+ * 6 = Universe number
+ * 7 = Processing level
+ * 8 = Software version
+ * 9/10 = Standard packet length
+ * 11/12 = Number of packets since last SIP
+ * 13/14 = Originating device's manufacturer ID
+ * 15-22 = Manufacturer IDs of other devices
+ * 23 = reserved
+ * 24 = SIP checksum
+ *
+ * The checksum of the previous packet can only be verified if
+ * that packet was no longer than what we received.
+ */
+static int scSIP(int size)
+{
+    uint8_t sum = 0;
+    int cnt = data[1];
+
+    if(cnt < 24 || cnt >= size) {
+        sipInfo.badSIP++;
+        return 0;
+    }
+
+    for(int i = 0; i < cnt; i++) {
+        sum += data[i];
+    }
+    if(sum != data[cnt]) {
+        sipInfo.badSIP++;
+        return 0;
+    }
+
+    sipInfo.prevChecksum = (data[3] << 8) | data[4];
+    sipInfo.seq          = data[5];
+    sipInfo.universe     = data[6];
+    sipInfo.procLevel    = data[7];
+    sipInfo.swVersion    = data[8];
+    sipInfo.pktLength    = (data[9] << 8) | data[10];
+    sipInfo.pktCount     = (data[11] << 8) | data[12];
+    sipInfo.manufId      = (data[13] << 8) | data[14];
+    sipInfo.received++;
+
+    if(sipActive && sipInfo.pktLength + 1 == lastSize) {
+        if(sipInfo.prevChecksum != lastChecksum) {
+            sipInfo.badChecksum++;
+            log_event(LOG_SIP_CHECKSUM, lastChecksum, sipInfo.prevChecksum);
+        }
+    }
+
+    sipActive = true;
+    lastSize = 0;
+
+    return 0;
+}
+
+/*
+ * Manufacturer specific packet (0x91)
+ * 1/2 = ESTA Manufacturer ID
+ *
+ * Timecode (Manufacturer ID DMX_TIMECODE_MANUF_ID):
+ * 3 = Hours (0-23)
+ * 4 = Minutes (0-59)
+ * 5 = Seconds (0-59)
+ * 6 = Frames
+ *
+ * Displays in timecode mode show the timecode's hours and minutes.
+ * With TC_BLINK_LOCK, the packet in which the seconds change is the
+ * reference for the colons' blink.
+ */
+static int scManuf(int size)
+{
+    uint32_t ret = 0;
+
+    if(size < 7 || ((data[1] << 8) | data[2]) != DMX_TIMECODE_MANUF_ID)
+        return 0;
+
+    if(data[3] > 23 || data[4] > 59)
+        return 0;
+
+    #ifdef TC_BLINK_LOCK
+    if(data[5] <= 59 && data[5] != tcSecond) {
+        // The first second seen may have started before
+        if(tcSecond != 255) blinkReference((uint32_t)rxBreak);
+        tcSecond = data[5];
+    }
+    #endif
+
+    if(!tcValid || data[3] != tcHour || data[4] != tcMinute) {
+        tcHour = data[3];
+        tcMinute = data[4];
+        tcValid = true;
+
+        for(int d = 0; d < TC_NUM_DISPLAYS; d++) {
+            if(dispMode[d] == DM_TIMECODE) {
+                setDisplayTime(&displays[d], tcHour, tcMinute);
+                ret |= (1 << d);
+            }
+        }
+    }
+
+    return ret;
+}
@@ -14,12 +14,20 @@
 
 extern unsigned long powerupMillis;
 
-extern clockDisplay destinationTime;
-extern clockDisplay presentTime;
-extern clockDisplay departedTime;
+extern clockDisplay displays[TC_NUM_DISPLAYS];
+
+extern clockDisplay& destinationTime;
+extern clockDisplay& presentTime;
+extern clockDisplay& departedTime;
 
 void dmx_boot();
 void dmx_setup();
 void dmx_loop();
+#ifdef TC_DMX_TASK
+void dmx_start_tasks();
+#endif
+#ifdef TC_SOFTDIM
+uint32_t dmx_dim_budget(uint32_t clock, int *steps);
+#endif
 
 #endif
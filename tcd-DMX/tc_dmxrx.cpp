@@ -0,0 +1,227 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Lean DMX receiver
+ *
+ * A UART interrupt handler that takes packets straight from the
+ * UART's FIFO into one of three frame buffers:
+ *
+ * - FIFO full/timeout: Slots are copied to the write buffer, up to
+ *   the number of slots we need; the rest of the packet is discarded.
+ *   Once all slots we need are in, the packet is published.
+ * - Break: The FIFO is drained first (the ending packet's last slots
+ *   may still be in there). Then a new packet starts, the time is
+ *   taken. A packet that has not been published yet (because it is
+ *   shorter than the number of slots we need) is published now.
+ * - Overflow: The packet is published with an error.
+ * These are handled in this order, as they can be pending together.
+ *
+ * Publishing swaps the write buffer with the middle buffer and flags
+ * the middle buffer as fresh; the reader swaps its buffer with the
+ * middle buffer if that one is fresh. Neither side ever waits for the
+ * other, and the reader always gets the latest packet.
+ *
+ * No RDM; slot framing errors are not detected.
+ * -------------------------------------------------------------------
+ */
+
+#include "tc_global.h"
+
+#ifdef TC_LEAN_RX
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_dmx.h>
+#include <driver/uart.h>
+#include <hal/uart_ll.h>
+#include <hal/cpu_hal.h>
+
+#include "tc_dmxrx.h"
+
+#define RX_UART         1
+#define RX_HW           UART_LL_GET_HW(RX_UART)
+#define RX_FIFO_THRESH  16      // Slots in FIFO that trigger an interrupt (~0.7ms)
+#define RX_TOUT         2       // Idle symbols after which the FIFO is read
+#define RX_INTR         (UART_INTR_BRK_DET | UART_INTR_RXFIFO_FULL | \
+                         UART_INTR_RXFIFO_TOUT | UART_INTR_RXFIFO_OVF)
+
+#define RX_FRESH        0x80    // Middle buffer holds an unread packet
+
+static struct {
+    int64_t  breakTime;
+    int      size;
+    int      err;
+    uint32_t words[(3 + DMXRX_PACKET_SIZE + 3) / 4];
+} rxFrames[3];
+
+static int                    rxWr = 0;         // ISR's buffer
+static int                    rxRd = 1;         // Reader's buffer
+static std::atomic<uint32_t>  rxMid(2);         // Middle buffer | RX_FRESH
+
+static int                    rxSlots = DMXRX_PACKET_SIZE;
+static int                    rxAlign = 0;
+static int                    rxPos = -1;       // Slots received; -1 = wait for break
+static bool                   rxDone = false;   // Packet published
+
+static SemaphoreHandle_t      rxSem = NULL;
+
+static uint32_t               rxCyclesMax = 0;
+static uint32_t               rxCycles = 0;
+static portMUX_TYPE           rxStatsLock = portMUX_INITIALIZER_UNLOCKED;
+
+static void IRAM_ATTR rxPublish(BaseType_t *woken)
+{
+    rxFrames[rxWr].size = max(rxPos, 0);
+    rxWr = rxMid.exchange(rxWr | RX_FRESH) & 3;
+    rxDone = true;
+
+    xSemaphoreGiveFromISR(rxSem, woken);
+}
+
+// Copy slots from the FIFO, leaving keep bytes in there
+static void IRAM_ATTR rxDrain(BaseType_t *woken, int keep)
+{
+    int n;
+
+    while((n = uart_ll_get_rxfifo_len(RX_HW) - keep) > 0) {
+        if(rxPos < 0 || rxDone) {
+            // Before the first break, or beyond the slots we need
+            uart_ll_rxfifo_rst(RX_HW);
+            break;
+        }
+        n = min(n, rxSlots - rxPos);
+        uart_ll_read_rxfifo(RX_HW, (uint8_t *)rxFrames[rxWr].words + rxAlign + rxPos, n);
+        rxPos += n;
+        if(rxPos >= rxSlots) {
+            rxPublish(woken);
+        }
+    }
+}
+
+static void IRAM_ATTR rxISR(void *arg)
+{
+    uint32_t   start = cpu_hal_get_cycle_count();
+    uint32_t   st = uart_ll_get_intsts_mask(RX_HW);
+    BaseType_t woken = pdFALSE;
+
+    // With a break, the last byte in the FIFO is the break's
+    // null byte; the ones before are the ending packet's
+    if(st & (UART_INTR_RXFIFO_FULL | UART_INTR_RXFIFO_TOUT | UART_INTR_BRK_DET)) {
+        rxDrain(&woken, (st & UART_INTR_BRK_DET) ? 1 : 0);
+    }
+
+    if(st & UART_INTR_BRK_DET) {
+        // Whatever is left in the FIFO is the break's null byte
+        // and slots beyond the ones we need
+        uart_ll_rxfifo_rst(RX_HW);
+        if(rxPos > 0 && !rxDone) {
+            // An overflow along with the break was in the ending packet
+            if(st & UART_INTR_RXFIFO_OVF) rxFrames[rxWr].err = DMX_ERR_UART_OVERFLOW;
+            rxPublish(&woken);
+        }
+        rxFrames[rxWr].breakTime = esp_timer_get_time();
+        rxFrames[rxWr].err = DMX_OK;
+        rxPos = 0;
+        rxDone = false;
+    }
+
+    if((st & UART_INTR_RXFIFO_OVF) && !(st & UART_INTR_BRK_DET)) {
+        uart_ll_rxfifo_rst(RX_HW);
+        if(rxPos >= 0 && !rxDone) {
+            rxFrames[rxWr].err = DMX_ERR_UART_OVERFLOW;
+            rxPublish(&woken);
+        }
+    }
+
+    uart_ll_clr_intsts_mask(RX_HW, st);
+
+    start = cpu_hal_get_cycle_count() - start;
+    portENTER_CRITICAL_ISR(&rxStatsLock);
+    rxCycles += start;
+    if(start > rxCyclesMax) rxCyclesMax = start;
+    portEXIT_CRITICAL_ISR(&rxStatsLock);
+
+    if(woken) portYIELD_FROM_ISR();
+}
+
+/*
+ * Set up the UART (250kbps, 8N2) and install the interrupt handler.
+ * slots: Number of slots (including the start code) to receive
+ * align: Offset of the start code in the frame buffers
+ */
+void dmxrx_setup(int rxPin, int slots, int align)
+{
+    uart_config_t cfg;
+
+    rxSlots = min(slots, DMXRX_PACKET_SIZE);
+    rxAlign = align & 3;
+    rxSem = xSemaphoreCreateBinary();
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.baud_rate = 250000;
+    cfg.data_bits = UART_DATA_8_BITS;
+    cfg.parity = UART_PARITY_DISABLE;
+    cfg.stop_bits = UART_STOP_BITS_2;
+    cfg.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    cfg.source_clk = UART_SCLK_APB;
+    uart_param_config(RX_UART, &cfg);
+    uart_set_pin(RX_UART, UART_PIN_NO_CHANGE, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+
+    uart_ll_set_rxfifo_full_thr(RX_HW, RX_FIFO_THRESH);
+    uart_ll_set_rx_tout(RX_HW, RX_TOUT);
+    uart_ll_clr_intsts_mask(RX_HW, UART_LL_INTR_MASK);
+
+    uart_isr_register(RX_UART, rxISR, NULL, ESP_INTR_FLAG_IRAM, NULL);
+    uart_ll_ena_intr_mask(RX_HW, RX_INTR);
+}
+
+/*
+ * Get the latest packet, waiting up to wait ticks if there is none.
+ * Returns the number of slots (0 = no packet). The data stays valid
+ * until the next call.
+ */
+int dmxrx_receive(uint8_t **data, int *err, int64_t *breakTime, TickType_t wait)
+{
+    TickType_t start = xTaskGetTickCount(), waited;
+
+    if(rxMid.load() & RX_FRESH) {
+        // The ISR's give for this frame is still pending; clear it,
+        // so that the next call waits
+        xSemaphoreTake(rxSem, 0);
+    } else {
+        // A give may be left over from a frame taken above, so wait
+        // until a fresh frame arrives or wait ticks are over
+        do {
+            waited = xTaskGetTickCount() - start;
+            if(waited >= wait || xSemaphoreTake(rxSem, wait - waited) != pdTRUE)
+                return 0;
+        } while(!(rxMid.load() & RX_FRESH));
+    }
+
+    rxRd = rxMid.exchange(rxRd) & 3;
+
+    *data = (uint8_t *)rxFrames[rxRd].words + rxAlign;
+    *err = rxFrames[rxRd].err;
+    *breakTime = rxFrames[rxRd].breakTime;
+
+    return rxFrames[rxRd].size;
+}
+
+/*
+ * Max cycles per interrupt, and total cycles since the last call
+ */
+void dmxrx_isr_stats(uint32_t *cyclesMax, uint32_t *cycles)
+{
+    // The ISR may run on the other core
+    portENTER_CRITICAL(&rxStatsLock);
+    *cyclesMax = rxCyclesMax;
+    *cycles = rxCycles;
+    rxCycles = 0;
+    portEXIT_CRITICAL(&rxStatsLock);
+}
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _TC_DMXRX_H
+#define _TC_DMXRX_H
+
+#ifdef TC_LEAN_RX
+
+#define DMXRX_PACKET_SIZE   513     // Start code + 512 slots
+
+void dmxrx_setup(int rxPin, int slots, int align);
+
+int  dmxrx_receive(uint8_t **data, int *err, int64_t *breakTime, TickType_t wait);
+
+void dmxrx_isr_stats(uint32_t *cyclesMax, uint32_t *cycles);
+
+#endif
+
+#endif
@@ -9,7 +9,7 @@
 #ifndef _TC_FONT_H
 #define _TC_FONT_H
 
-static const uint16_t alphaChars[127-31-1] = {
+static const TC_DRAM uint16_t alphaChars[127-31-1] = {
     0b0000000000000000,  // <space>
     0b0000000000000110,  // !
     0b0000001000100000,  // "
@@ -107,7 +107,7 @@ static const uint16_t alphaChars[127-31-1] = {
     0b0000000011100011   // ~ displayed as '°' (encoded as ~) [was: 0b0000010100100000]
 };
 
-static const uint8_t numDigs[127-31-1+2] = {
+static const TC_DRAM uint8_t numDigs[127-31-1+2] = {
     0b00000000, // space
     0b00000010, // !
     0b00100010, // "
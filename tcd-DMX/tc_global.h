@@ -24,6 +24,11 @@
 
 //#define TC_DBG              // debug output on Serial
 
+// If this is uncommented, micro benchmarks of the decoding and
+// rendering paths are run at boot, with results printed on Serial.
+// For development only.
+//#define TC_BENCH
+
 // If this is uncommented, the firmware uses channel DMX_VERIFY_CHANNEL
 // for packet verification. The value of this channel must, at all times,
 // be DMX_VERIFY_VALUE for a packet to be accepted.
@@ -37,9 +42,91 @@
 // of the TCD's channels.
 //#define TC_HAVESPEEDO
 // Speedo type. 0 for CircuitSetup's speedo display. See dispTypes in
-// speeddisplay.h for other supported types.
+// speeddisplay.h for other supported types. The display driver is
+// specialized for this type at compile time.
 #define TC_SPEEDO_TYPE    0
 
+// If this is uncommented, scene memory is supported: Scenes are
+// captured from the displays' current state and recalled through
+// DMX_SCENE_CHANNEL (see tc_dmx.cpp). Like the speedo, the scene
+// channels are another fixture.
+//#define TC_HAVESCENES
+
+// Number of TCD panels (sets of Destination, Present and Last Time
+// Departed displays). With more than one, panel n is connected to
+// channel n of a TCA9548A I2C multiplexer at TC_MUX_ADDR, and uses
+// the n-th footprint following DMX_ADDRESS. Max 8.
+#define TC_NUM_PANELS     1
+#define TC_MUX_ADDR    0x77
+
+// If this is uncommented, the ESP32's second I2C controller (Wire1,
+// on I2C1_SDA_PIN/I2C1_SCL_PIN) is used for the displays assigned to
+// bus 1 below (on all panels). Both buses are updated concurrently.
+// The RTC remains on bus 0.
+//#define TC_I2C_SPLIT
+#define TC_BUS_DEST       0
+#define TC_BUS_PRES       0
+#define TC_BUS_LAST       1
+#define TC_BUS_SPEEDO     1
+
+// I2C bus clock (Hz), for both buses. The displays, the RTCs and the
+// multiplexer support 400kHz; the keypad's PCF8574 (unused in the
+// DMX version, but on the bus) only supports 100kHz.
+#define TC_I2C_CLOCK 100000
+
+// If this is uncommented, DMX handling (receive, decode, display
+// updates) runs in its own task, pinned to core 1, and waits for
+// packets instead of polling. Housekeeping (statistics, RTC temperature)
+// stays in the DMX loop, as it uses the bus. The decoder's and the
+// display driver's hot paths and tables are placed in IRAM/DRAM, so
+// they are not subject to flash cache misses.
+//#define TC_DMX_TASK
+
+// If this is uncommented, DMX is received by a lean UART interrupt
+// handler (tc_dmxrx.cpp) instead of the esp_dmx driver. It keeps only
+// the slots in use, with no copying after the interrupt. There is no
+// RDM then, so the personality can't be changed (the standard
+// personality, or the user personality, is used).
+//#define TC_LEAN_RX
+
+// If this is uncommented, the render pipeline (packet receive and
+// decode, I2C transactions, 1Hz edges) is traced into a RAM ring
+// buffer, which is dumped on Serial when 't' is received there (Serial
+// input is reserved for this; other bytes are discarded).
+// See tc_trace.cpp. For development only.
+//#define TC_TRACE
+
+// If this is uncommented, the colons blink in phase with the DMX
+// signal instead of the RTC's 1Hz signal, so that several TCDs on the
+// same universe blink together. The reference is the start of each
+// timecode second (see scManuf() in tc_dmx.cpp) or a rising edge on
+// the blink channel (DMX_BLINK_CHANNEL). The blink phase is derived
+// from the 1Hz signal, disciplined by a small PLL to the reference,
+// and held when the reference stops. The phase error is logged.
+// Requires TC_LEAN_RX, which takes the time of each packet's break;
+// the esp_dmx driver does not.
+//#define TC_BLINK_LOCK
+
+// If this is uncommented, the fields of each display (month, day,
+// year, hour, minute) can be dimmed separately, through the channels
+// at DMX_DIM_CHANNEL (see tc_dmx.cpp): Fields are blanked and restored
+// in display RAM at a fixed rate (software PWM). The rate and the
+// number of levels follow from TC_I2C_CLOCK; 100kHz is too slow for
+// this, 400kHz gives a few levels.
+//#define TC_SOFTDIM
+
+#if defined(TC_BLINK_LOCK) && !defined(TC_LEAN_RX)
+#error "TC_BLINK_LOCK requires TC_LEAN_RX"
+#endif
+
+#ifdef TC_DMX_TASK
+#define TC_IRAM IRAM_ATTR
+#define TC_DRAM DRAM_ATTR
+#else
+#define TC_IRAM
+#define TC_DRAM
+#endif
+
 /*************************************************************************
  ***                             GPIO pins                             ***
  *************************************************************************/
@@ -63,6 +150,10 @@
 
 #define VOLUME_PIN        32      // analog input pin (unused in DMX version)
 
+// Second I2C bus (TC_I2C_SPLIT)
+#define I2C1_SDA_PIN      33      // (I2S DIN pin, unused in DMX version)
+#define I2C1_SCL_PIN      32      // (Volume pin, unused in DMX version)
+
 // DMX
 #define DMX_TRANSMIT      14
 #define DMX_RECEIVE       13
@@ -77,6 +168,10 @@
 #define DISP_PRES     1
 #define DISP_LAST     2
 
+// Num of TC displays (all panels); display index is
+// panel * 3 + display ID
+#define TC_NUM_DISPLAYS (TC_NUM_PANELS * 3)
+
 // Num of characters on display
 #define DISP_LEN      13
 
@@ -0,0 +1,240 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Logging
+ *
+ * Events are stored in binary form in a lock-free ring buffer, and
+ * formatted/printed by a low-priority task. Producers never block;
+ * if the ring is full, events are dropped and counted.
+ * Identical events within LOG_REPEAT_MS are printed only once,
+ * followed by a summary with the number of repeats.
+ * -------------------------------------------------------------------
+ */
+
+#include "tc_global.h"
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "tc_log.h"
+
+#define LOG_RING_SIZE     64    // Must be a power of 2
+#define LOG_REPEAT_MS   1000    // Window for collapsing identical events
+#define LOG_TASK_CORE      0
+#define LOG_TASK_PRIO      1
+
+struct logEvent {
+    uint32_t time;              // millis()
+    uint8_t  id : 5;
+    uint8_t  panel : 3;         // LOG_DISP_DATA*
+    uint8_t  data[LOG_DATA_SIZE];
+};
+
+static_assert(LOG_NUM_IDS <= 32 && TC_NUM_PANELS <= 8, "logEvent id/panel too small");
+static_assert(sizeof(logEvent) == 16, "logEvent is not 16 bytes");
+
+static struct {
+    std::atomic<uint32_t> seq;
+    logEvent              ev;
+} logRing[LOG_RING_SIZE];
+
+static std::atomic<uint32_t> logHead(0);
+static uint32_t              logTail = 0;
+static std::atomic<uint32_t> logDropped(0);
+
+static const char *logStrings[LOG_NUM_IDS] = {
+    "DMX is connected",
+    "DMX was disconnected",
+    "DMX error: %d",
+    "Bad verification value on channel %d: %d",
+    "Unrecognized start code %d (0x%02x)",
+    "SIP: Checksum mismatch for previous packet (%04x, should be %04x)",
+    "DT:",
+    "PT:",
+    "LT:",
+    "Scene %d recalled",
+    "Scene %d captured",
+    "Cue at second %d of day: action %d",
+    "I2C traffic over budget: %d bytes (budget %d)",
+    "Blink locked, phase error %d us",
+    "Blink lost its reference, holding phase",
+    "Blink phase error %d us (max %d us)"
+};
+
+static void logTask(void *parameter);
+
+void log_setup()
+{
+    for(uint32_t i = 0; i < LOG_RING_SIZE; i++) {
+        logRing[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    xTaskCreatePinnedToCore(logTask, "log", 3072, NULL, LOG_TASK_PRIO, NULL, LOG_TASK_CORE);
+}
+
+/*
+ * Store an event in the ring buffer
+ * Safe to be called from any task; never blocks.
+ */
+static logEvent *log_alloc(uint32_t& pos)
+{
+    int32_t dif;
+
+    pos = logHead.load(std::memory_order_relaxed);
+
+    for(;;) {
+        dif = (int32_t)(logRing[pos & (LOG_RING_SIZE - 1)].seq.load(std::memory_order_acquire) - pos);
+        if(!dif) {
+            if(logHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if(dif < 0) {
+            logDropped++;
+            return NULL;
+        } else {
+            pos = logHead.load(std::memory_order_relaxed);
+        }
+    }
+
+    return &logRing[pos & (LOG_RING_SIZE - 1)].ev;
+}
+
+static void log_commit(uint32_t pos)
+{
+    logRing[pos & (LOG_RING_SIZE - 1)].seq.store(pos + 1, std::memory_order_release);
+}
+
+void log_event(uint8_t id, uint32_t a, uint32_t b)
+{
+    uint32_t pos;
+    logEvent *ev;
+
+    if(!(ev = log_alloc(pos)))
+        return;
+
+    ev->time = millis();
+    ev->id = id;
+    ev->panel = 0;
+    memset(ev->data, 0, LOG_DATA_SIZE);
+    memcpy(ev->data, &a, 4);
+    memcpy(ev->data + 4, &b, 4);
+
+    log_commit(pos);
+}
+
+void log_event_data(uint8_t id, const uint8_t *data, int len, uint8_t panel)
+{
+    uint32_t pos;
+    logEvent *ev;
+
+    if(!(ev = log_alloc(pos)))
+        return;
+
+    if(len > LOG_DATA_SIZE) len = LOG_DATA_SIZE;
+
+    ev->time = millis();
+    ev->id = id;
+    ev->panel = panel;
+    memset(ev->data, 0, LOG_DATA_SIZE);
+    memcpy(ev->data, data, len);
+
+    log_commit(pos);
+}
+
+/*
+ * Consumer
+ */
+
+static bool log_get(logEvent& ev)
+{
+    uint32_t seq = logRing[logTail & (LOG_RING_SIZE - 1)].seq.load(std::memory_order_acquire);
+
+    if((int32_t)(seq - (logTail + 1)) < 0)
+        return false;
+
+    ev = logRing[logTail & (LOG_RING_SIZE - 1)].ev;
+
+    logRing[logTail & (LOG_RING_SIZE - 1)].seq.store(logTail + LOG_RING_SIZE, std::memory_order_release);
+    logTail++;
+
+    return true;
+}
+
+static void log_print(const logEvent& ev)
+{
+    uint32_t a, b;
+
+    Serial.printf("[%6lu.%03lu] ", (unsigned long)(ev.time / 1000), (unsigned long)(ev.time % 1000));
+
+    if(ev.id >= LOG_NUM_IDS) {
+        Serial.printf("Unknown event %d\n", ev.id);
+        return;
+    }
+
+    switch(ev.id) {
+    case LOG_DISP_DATA:
+    case LOG_DISP_DATA_PT:
+    case LOG_DISP_DATA_LT:
+        if(TC_NUM_PANELS > 1) {
+            Serial.printf("Panel %d ", ev.panel + 1);
+        }
+        Serial.print(logStrings[ev.id]);
+        for(int i = 0; i < LOG_DATA_SIZE; i++) {
+            Serial.printf(" %02x", ev.data[i]);
+        }
+        break;
+    default:
+        memcpy(&a, ev.data, 4);
+        memcpy(&b, ev.data + 4, 4);
+        Serial.printf(logStrings[ev.id], (int)a, (int)b);
+    }
+    Serial.println();
+}
+
+static void log_print_repeats(uint32_t repeats)
+{
+    Serial.printf("         (last message repeated %lu times)\n", (unsigned long)repeats);
+}
+
+static void logTask(void *parameter)
+{
+    logEvent ev, last;
+    uint32_t repeats = 0, dropped = 0, now;
+    bool haveLast = false;
+
+    for(;;) {
+
+        while(log_get(ev)) {
+            if(haveLast && ev.id == last.id && ev.panel == last.panel &&
+               !memcmp(ev.data, last.data, LOG_DATA_SIZE) &&
+               ev.time - last.time < LOG_REPEAT_MS) {
+                repeats++;
+                continue;
+            }
+            if(repeats) {
+                log_print_repeats(repeats);
+                repeats = 0;
+            }
+            log_print(ev);
+            last = ev;
+            haveLast = true;
+        }
+
+        now = millis();
+        if(repeats && (now - last.time >= LOG_REPEAT_MS)) {
+            log_print_repeats(repeats);
+            repeats = 0;
+            haveLast = false;
+        }
+
+        if((now = logDropped.load()) != dropped) {
+            Serial.printf("         (%lu log events dropped)\n", (unsigned long)(now - dropped));
+            dropped = now;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
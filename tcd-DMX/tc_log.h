@@ -0,0 +1,40 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _TC_LOG_H
+#define _TC_LOG_H
+
+// Log event IDs
+enum {
+    LOG_DMX_CONNECTED = 0,
+    LOG_DMX_DISCONNECTED,
+    LOG_DMX_ERROR,              // a = error
+    LOG_BAD_VERIFY,             // a = channel, b = value
+    LOG_UNKNOWN_SC,             // a, b = start code
+    LOG_SIP_CHECKSUM,           // a = our checksum, b = SIP's checksum
+    LOG_DISP_DATA,              // data = 11 channels (DT), panel
+    LOG_DISP_DATA_PT,           // " (PT)
+    LOG_DISP_DATA_LT,           // " (LT)
+    LOG_SCENE_RECALL,           // a = scene (0 = live)
+    LOG_SCENE_CAPTURE,          // a = scene
+    LOG_CUE,                    // a = second of day, b = action
+    LOG_I2C_BUDGET,             // a = bytes, b = budget
+    LOG_BLINK_LOCKED,           // a = phase error (us)
+    LOG_BLINK_LOST,
+    LOG_BLINK_PHASE,            // a = phase error (us), b = max
+    LOG_NUM_IDS
+};
+
+#define LOG_DATA_SIZE 11
+
+void log_setup();
+
+void log_event(uint8_t id, uint32_t a = 0, uint32_t b = 0);
+void log_event_data(uint8_t id, const uint8_t *data, int len, uint8_t panel = 0);
+
+#endif
@@ -0,0 +1,456 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * DMX personality
+ *
+ * This is the one and only definition of the TCD's DMX channel layout.
+ * The firmware's decoder is instantiated from it at compile time, and
+ * tools/genfixtures.cpp generates the fixture definition and the
+ * README's channel table from it. After changing anything here, re-run
+ * the generator.
+ *
+ * This file is also compiled on the host, so it must not depend on
+ * anything from the Arduino environment.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _TC_PERSONALITY_H
+#define _TC_PERSONALITY_H
+
+#include <stdint.h>
+
+// Memory placement of the lookup tables (see tc_global.h); none on
+// the host
+#ifndef TC_DRAM
+#define TC_DRAM
+#endif
+
+// Field types. The decoder stores each field's value at index [type].
+// PF_MONTH-PF_AMPM are the date/time fields, and must be contiguous.
+enum : uint8_t {
+    PF_MONTH = 0,       // 0 = blank, 1-12
+    PF_DAY,             // 0 = blank, 1-31
+    PF_YEAR1000,        // 0 = blank, 1-10 = digit 0-9
+    PF_YEAR100,         // "
+    PF_YEAR10,          // "
+    PF_YEAR1,           // "
+    PF_HOUR,            // 0 = blank, 1-13 = hour 0-12
+    PF_MINUTE,          // 0 = blank, 1-60 = minute 0-59
+    PF_AMPM,            // 0 = PM, 1 = AM
+    PF_COLON,           // 0 = off, 1 = on, 2 = blink
+    PF_BRIGHTNESS,      // 0 = off, 1-16 = level 0-15
+    PF_NUM,
+    PF_MODE = PF_NUM,   // Display mode (split index)
+    PF_RATE,            // Free-running clock rate (raw)
+    PF_YEAR16,          // 16-bit year; decoded to PF_YEARxxx
+    PF_TIME16,          // 16-bit minute of day; decoded to PF_HOUR-PF_AMPM
+    PF_SEGMENTS         // Raw display RAM byte; not decoded
+};
+
+#define PF_DATETIME_NUM (PF_AMPM + 1)
+
+// Range mappings
+enum : uint8_t {
+    PM_TABLE = 0,       // Lookup table; param = table index
+    PM_DIV,             // Value / param
+    PM_SPLIT,           // Index of first capability whose max >= value
+    PM_BRIGHT,          // 0 = off, otherwise (value / 16) + 1
+    PM_RAW,             // Value (decoded elsewhere)
+    PM_WORD,            // 16 bit: Value * 256 + next slot's value
+    PM_FINE             // Low byte of the preceding PM_WORD slot
+};
+
+// Lookup tables
+enum : uint8_t {
+    PT_MONTH = 0,
+    PT_YEAR,
+    PT_HOUR,
+    PT_MINUTE
+};
+
+// Documentation flags
+#define PFL_DOC_CAPS  0x01  // List capabilities in README table
+#define PFL_DOC_BELOW 0x02  // Refer to README text
+
+struct persCap {
+    uint8_t     max;            // Upper end of value range
+    const char *label;
+};
+
+struct persField {
+    uint8_t         type;       // PF_xxx
+    uint8_t         map;        // PM_xxx
+    uint8_t         param;      // Table index or divisor
+    uint8_t         numCaps;
+    const persCap  *caps;       // Value ranges (PM_SPLIT), or documentation
+    const char     *name;       // Short name (fixture definitions)
+    const char     *desc;       // Description (README)
+    const char     *capFmt;     // Label for derived capabilities (value + capOffs)
+    int8_t          capOffs;
+    const char     *group;      // QLC+ channel group
+    uint8_t         flags;      // PFL_xxx
+};
+
+#define PERS_NUM_DISPLAYS   3
+
+static constexpr const char *persDisplayNames[PERS_NUM_DISPLAYS] = {
+    "DT", "PT", "LT"
+};
+static constexpr const char *persDisplayDesc[PERS_NUM_DISPLAYS] = {
+    "Destination Time", "Present Time", "Last Time Departed"
+};
+
+static constexpr persCap persCapsAMPM[] = {
+    { 127, "PM" }, { 255, "AM" }
+};
+static constexpr persCap persCapsColon[] = {
+    { 85, "off" }, { 170, "on" }, { 255, "blink" }
+};
+static constexpr persCap persCapsBright[] = {
+    { 0, "off" }, { 255, "darkest-brightest" }
+};
+// Order must match the DM_xxx display modes in tc_dmx.cpp
+static constexpr persCap persCapsMode[] = {
+    { 31, "DMX" }, { 63, "Real time clock" }, { 95, "Free-running clock" },
+    { 127, "Timecode" }, { 255, "Reserved (DMX)" }
+};
+static constexpr persCap persCapsRate[] = {
+    { 127, "Reverse (fast to slow)" }, { 255, "Forward (slow to fast)" }
+};
+
+#define PERS_CAPS(a) (uint8_t)(sizeof(a) / sizeof(a[0])), a
+
+/*
+ * Each display's channels, in order
+ */
+static constexpr persField persDisplayFields[] = {
+    { PF_MONTH,      PM_TABLE,  PT_MONTH,  0, nullptr,                  "Month",     "Month",      "%d", 0,  "Effect",    0 },
+    { PF_DAY,        PM_DIV,    8,         0, nullptr,                  "Day",       "Day",        "%d", 0,  "Effect",    0 },
+    { PF_YEAR1000,   PM_TABLE,  PT_YEAR,   0, nullptr,                  "Y1000",     "Year 1000s", "%d", -1, "Effect",    0 },
+    { PF_YEAR100,    PM_TABLE,  PT_YEAR,   0, nullptr,                  "Y100",      "Year 100s",  "%d", -1, "Effect",    0 },
+    { PF_YEAR10,     PM_TABLE,  PT_YEAR,   0, nullptr,                  "Y10",       "Year 10s",   "%d", -1, "Effect",    0 },
+    { PF_YEAR1,      PM_TABLE,  PT_YEAR,   0, nullptr,                  "Y1",        "Year 1s",    "%d", -1, "Effect",    0 },
+    { PF_HOUR,       PM_TABLE,  PT_HOUR,   0, nullptr,                  "Hour",      "Hour",       "%d", -1, "Effect",    0 },
+    { PF_MINUTE,     PM_TABLE,  PT_MINUTE, 0, nullptr,                  "Min",       "Minute",     "%02d", -1, "Effect",  0 },
+    { PF_AMPM,       PM_SPLIT,  0,         PERS_CAPS(persCapsAMPM),     "AMPM",      "AM/PM",      nullptr, 0, "Effect",  PFL_DOC_CAPS },
+    { PF_COLON,      PM_SPLIT,  0,         PERS_CAPS(persCapsColon),    "Colon",     "Colon",      nullptr, 0, "Effect",  PFL_DOC_CAPS },
+    { PF_BRIGHTNESS, PM_BRIGHT, 0,         PERS_CAPS(persCapsBright),   "Intensity", "Brightness", nullptr, 0, "Intensity", PFL_DOC_CAPS }
+};
+
+/*
+ * Channels with one slot per display, following the displays' channels
+ * (all slots of the first field, then all slots of the second, etc)
+ */
+enum : uint8_t {
+    PG_MODE = 0,
+    PG_RATE
+};
+static constexpr persField persGlobalFields[] = {
+    { PF_MODE,       PM_SPLIT,  0,         PERS_CAPS(persCapsMode),     "Mode",      "Mode",       nullptr, 0, "Effect",  PFL_DOC_BELOW },
+    { PF_RATE,       PM_RAW,    0,         PERS_CAPS(persCapsRate),     "Rate",      "Clock rate", nullptr, 0, "Speed",   PFL_DOC_BELOW }
+};
+
+/*
+ * 16-bit personality: Each display's channels, in order
+ *
+ * Year and time are 16-bit values (coarse/fine), so a console changes
+ * them in one step instead of through several banded channels.
+ * Year: 0-9999, time: minute of day, 0-1439; larger values blank the
+ * field. Mode and rate channels are the same as above.
+ */
+static constexpr persField persDisplayFields16[] = {
+    { PF_MONTH,      PM_TABLE,  PT_MONTH,  0, nullptr,                  "Month",     "Month",      "%d", 0,  "Effect",    0 },
+    { PF_DAY,        PM_DIV,    8,         0, nullptr,                  "Day",       "Day",        "%d", 0,  "Effect",    0 },
+    { PF_YEAR16,     PM_WORD,   0,         0, nullptr,                  "Year",      "Year (coarse)", nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_YEAR16,     PM_FINE,   0,         0, nullptr,                  "Year fine", "Year (fine)",   nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_TIME16,     PM_WORD,   0,         0, nullptr,                  "Time",      "Time (coarse)", nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_TIME16,     PM_FINE,   0,         0, nullptr,                  "Time fine", "Time (fine)",   nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_COLON,      PM_SPLIT,  0,         PERS_CAPS(persCapsColon),    "Colon",     "Colon",      nullptr, 0, "Effect",  PFL_DOC_CAPS },
+    { PF_BRIGHTNESS, PM_BRIGHT, 0,         PERS_CAPS(persCapsBright),   "Intensity", "Brightness", nullptr, 0, "Intensity", PFL_DOC_CAPS }
+};
+
+/*
+ * Raw segment personality: Each display's channels, in order
+ *
+ * Two slots per column word of the display's RAM (HT16K33), low byte
+ * first, written to the display as they are: Columns 1-3 are the
+ * month's letters, 4 the day (with AM/PM), 5 and 6 the year (with
+ * the colon), 7 the hour, 8 the minute. There are no mode and rate
+ * channels.
+ */
+static constexpr persField persDisplayFieldsRaw[] = {
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C1 lo",    "Column 1 (low byte)",    nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C1 hi",    "Column 1 (high byte)",   nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C2 lo",    "Column 2 (low byte)",    nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C2 hi",    "Column 2 (high byte)",   nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C3 lo",    "Column 3 (low byte)",    nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C3 hi",    "Column 3 (high byte)",   nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C4 lo",    "Column 4 (low byte)",    nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C4 hi",    "Column 4 (high byte)",   nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C5 lo",    "Column 5 (low byte)",    nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C5 hi",    "Column 5 (high byte)",   nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C6 lo",    "Column 6 (low byte)",    nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C6 hi",    "Column 6 (high byte)",   nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C7 lo",    "Column 7 (low byte)",    nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C7 hi",    "Column 7 (high byte)",   nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C8 lo",    "Column 8 (low byte)",    nullptr, 0, "Effect", PFL_DOC_BELOW },
+    { PF_SEGMENTS,   PM_RAW,    0,         0, nullptr,                  "C8 hi",    "Column 8 (high byte)",   nullptr, 0, "Effect", PFL_DOC_BELOW }
+};
+
+#define PERS_DISPLAY_SLOTS  (int)(sizeof(persDisplayFields) / sizeof(persDisplayFields[0]))
+#define PERS_DISPLAY16_SLOTS (int)(sizeof(persDisplayFields16) / sizeof(persDisplayFields16[0]))
+#define PERS_DISPLAYRAW_SLOTS (int)(sizeof(persDisplayFieldsRaw) / sizeof(persDisplayFieldsRaw[0]))
+#define PERS_GLOBAL_FIELDS  (int)(sizeof(persGlobalFields) / sizeof(persGlobalFields[0]))
+#define PERS_FOOTPRINT      ((PERS_DISPLAY_SLOTS + PERS_GLOBAL_FIELDS) * PERS_NUM_DISPLAYS)
+
+// Slot (relative to DMX start address) of a global field for a display
+#define PERS_GLOBAL_SLOT(field, did) (PERS_DISPLAY_SLOTS * PERS_NUM_DISPLAYS + (field) * PERS_NUM_DISPLAYS + (did))
+
+/*
+ * Built-in personalities; index is RDM personality number - 1
+ */
+enum : uint8_t {
+    PERS_STANDARD = 0,
+    PERS_16BIT,
+    PERS_RAW,
+    PERS_NUM
+};
+
+struct persDesc {
+    const char      *name;      // QLC+ mode name
+    const char      *desc;      // RDM personality description
+    const persField *fields;    // Each display's channels
+    uint8_t          numFields;
+    uint8_t          numGlobals; // Global fields (mode, rate) used
+};
+
+static constexpr persDesc persPersonalities[PERS_NUM] = {
+    { "Standard mode",    "TCD Personality",             persDisplayFields,    PERS_DISPLAY_SLOTS,    PERS_GLOBAL_FIELDS },
+    { "16-bit mode",      "TCD 16-bit Personality",      persDisplayFields16,  PERS_DISPLAY16_SLOTS,  PERS_GLOBAL_FIELDS },
+    { "Raw segment mode", "TCD Raw Segment Personality", persDisplayFieldsRaw, PERS_DISPLAYRAW_SLOTS, 0 }
+};
+
+static constexpr int persFootprint(int p)
+{
+    return (persPersonalities[p].numFields + persPersonalities[p].numGlobals) * PERS_NUM_DISPLAYS;
+}
+
+static constexpr int persGlobalSlot(int p, int field, int did)
+{
+    return persPersonalities[p].numFields * PERS_NUM_DISPLAYS + field * PERS_NUM_DISPLAYS + did;
+}
+
+/*
+ * Lookup tables (read for every frame)
+ */
+
+static constexpr TC_DRAM uint8_t monthRanges[256] = {
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+     3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,
+     6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6,  6, 
+     7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+     9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12
+};    
+static constexpr TC_DRAM uint8_t yearRanges[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   // 0-23
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,      // 24-46
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,      // 47-69
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,   // 70-93
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,      // 94-116
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,      // 117-139
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,      // 140-162
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,   // 163-186
+    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,      // 187-209
+    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,      // 210-232
+   10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10       // 233-255
+};
+
+static constexpr TC_DRAM uint8_t hourRanges[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,        // 0-18
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,           // 19-36
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,           // 37-54
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,           // 55-72
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,           // 73-90
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,           // 91-108
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,           // 109-126
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,           // 127-144
+    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,           // 145-162
+    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,           // 163-180
+   10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,           // 181-198
+   11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,           // 199-216
+   12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,           // 217-234
+   13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13   // 235-255
+};
+
+static constexpr TC_DRAM uint8_t minRanges[256] = {
+    0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,  // 0-16
+    4, 4, 4, 4, 5, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,  // 17-33
+    8, 8, 8, 8, 9, 9, 9, 9,10,10,10,10,10,11,11,11,11,  // 34-50
+   12,12,12,12,13,13,13,13,14,14,14,14,15,15,15,15,15,  // 51-67
+   16,16,16,16,17,17,17,17,18,18,18,18,19,19,19,19,     // 68-83
+   20,20,20,20,20,21,21,21,21,22,22,22,22,23,23,23,23,  // 84-100
+   24,24,24,24,25,25,25,25,25,26,26,26,26,27,27,27,27,  // 101-117
+   28,28,28,28,29,29,29,29,30,30,30,30,30,31,31,31,31,  // 118-134
+   32,32,32,32,33,33,33,33,34,34,34,34,35,35,35,35,35,  // 135-151
+   36,36,36,36,37,37,37,37,38,38,38,38,39,39,39,39,     // 152-167
+   40,40,40,40,40,41,41,41,41,42,42,42,42,43,43,43,43,  // 168-184
+   44,44,44,44,45,45,45,45,45,46,46,46,46,47,47,47,47,  // 185-201
+   48,48,48,48,49,49,49,49,50,50,50,50,50,51,51,51,51,  // 202-218
+   52,52,52,52,53,53,53,53,54,54,54,54,55,55,55,55,55,  // 219-235
+   56,56,56,56,57,57,57,57,58,58,58,58,59,59,59,59,     // 236-251
+   60,60,60,60                                          // 252-255
+};
+
+static constexpr const uint8_t *persTables[] = {
+    monthRanges, yearRanges, hourRanges, minRanges
+};
+
+/*
+ * Decoder
+ *
+ * Unrolled at compile time; each field compiles to a table lookup,
+ * a division or a few compares.
+ */
+
+enum : uint8_t {
+    PERS_DISPLAY = 0,
+    PERS_GLOBAL,
+    PERS_DISPLAY16
+};
+
+static constexpr const persField& persGet(int set, int f)
+{
+    return set == PERS_DISPLAY   ? persDisplayFields[f] :
+           set == PERS_DISPLAY16 ? persDisplayFields16[f] :
+                                   persGlobalFields[f];
+}
+
+static constexpr int persCount(int set)
+{
+    return set == PERS_DISPLAY   ? PERS_DISPLAY_SLOTS :
+           set == PERS_DISPLAY16 ? PERS_DISPLAY16_SLOTS :
+                                   PERS_GLOBAL_FIELDS;
+}
+
+template<int S, int F, int C, bool Last = (C + 1 >= persGet(S, F).numCaps)>
+struct persSplit {
+    static inline uint8_t map(uint8_t val)
+    {
+        return (val <= persGet(S, F).caps[C].max) ? C : persSplit<S, F, C + 1>::map(val);
+    }
+};
+
+template<int S, int F, int C>
+struct persSplit<S, F, C, true> {
+    static inline uint8_t map(uint8_t)
+    {
+        return C;
+    }
+};
+
+template<int S, int F>
+static inline uint8_t persMap(uint8_t val)
+{
+    // (Table index is only valid for PM_TABLE)
+    return (persGet(S, F).map == PM_TABLE)  ? persTables[persGet(S, F).map == PM_TABLE ? persGet(S, F).param : 0][val] :
+           (persGet(S, F).map == PM_DIV)    ? val / persGet(S, F).param :
+           (persGet(S, F).map == PM_BRIGHT) ? (val ? (val / 16) + 1 : 0) :
+           (persGet(S, F).map == PM_SPLIT)  ? persSplit<S, F, 0>::map(val) :
+                                              val;
+}
+
+// 16-bit year (0-9999) to year digits; larger values blank the year
+static inline void persYear16(uint16_t w, uint8_t *out)
+{
+    if(w > 9999) {
+        out[PF_YEAR1000] = out[PF_YEAR100] = out[PF_YEAR10] = out[PF_YEAR1] = 0;
+        return;
+    }
+    out[PF_YEAR1] = (w % 10) + 1;
+    w /= 10;
+    out[PF_YEAR10] = (w % 10) + 1;
+    w /= 10;
+    out[PF_YEAR100] = (w % 10) + 1;
+    out[PF_YEAR1000] = (w / 10) + 1;
+}
+
+// 16-bit minute of day (0-1439) to hour, minute and AM/PM;
+// larger values blank hour and minute
+static inline void persTime16(uint16_t w, uint8_t *out)
+{
+    if(w >= 24 * 60) {
+        out[PF_HOUR] = out[PF_MINUTE] = 0;
+        out[PF_AMPM] = 1;
+        return;
+    }
+    uint8_t hour = w / 60;
+    uint8_t hour12 = hour % 12;
+    out[PF_MINUTE] = w - (hour * 60) + 1;
+    out[PF_HOUR] = (hour12 ? hour12 : 12) + 1;
+    out[PF_AMPM] = (hour < 12) ? 1 : 0;
+}
+
+template<int S, int F>
+static inline void persStore(const uint8_t *src, uint8_t *out)
+{
+    // (Index is only valid for 8-bit fields)
+    if(persGet(S, F).map == PM_WORD) {
+        uint16_t w = (src[F] << 8) | src[F + 1];
+        if(persGet(S, F).type == PF_YEAR16) {
+            persYear16(w, out);
+        } else {
+            persTime16(w, out);
+        }
+    } else if(persGet(S, F).map != PM_FINE) {
+        out[persGet(S, F).type < PF_NUM ? persGet(S, F).type : 0] = persMap<S, F>(src[F]);
+    }
+}
+
+template<int S, int F, bool End = (F >= persCount(S))>
+struct persDecoder {
+    static inline void run(const uint8_t *src, uint8_t *out)
+    {
+        persStore<S, F>(src, out);
+        persDecoder<S, F + 1>::run(src, out);
+    }
+};
+
+template<int S, int F>
+struct persDecoder<S, F, true> {
+    static inline void run(const uint8_t *, uint8_t *)
+    {
+    }
+};
+
+// Decode a display's channels; out must hold PF_NUM values
+static inline void persDecode(const uint8_t *src, uint8_t *out)
+{
+    persDecoder<PERS_DISPLAY, 0>::run(src, out);
+}
+
+// Same for the 16-bit personality
+static inline void persDecode16(const uint8_t *src, uint8_t *out)
+{
+    persDecoder<PERS_DISPLAY16, 0>::run(src, out);
+}
+
+// Decode the value of a global field
+template<int F>
+static inline uint8_t persDecodeGlobal(uint8_t val)
+{
+    return persMap<PERS_GLOBAL, F>(val);
+}
+
+#endif
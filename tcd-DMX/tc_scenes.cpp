@@ -0,0 +1,113 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Scene memory
+ *
+ * A scene is the rendered state of all displays (display buffers,
+ * brightness, colon and AM/PM), captured from what is currently
+ * shown. Scenes are stored in NVS, one blob per scene, and kept in
+ * RAM so that a recall is a plain copy to the displays.
+ * -------------------------------------------------------------------
+ */
+
+#include "tc_global.h"
+
+#ifdef TC_HAVESCENES
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "tc_scenes.h"
+
+#define SC_VERSION      1
+
+static const char *scNVSName = "tcdscenes";
+
+static struct {
+    uint8_t   version;
+    uint8_t   valid;
+    sceneData sd;
+} scenes[SCENE_NUM];
+
+static void sceneKey(char *key, int scene)
+{
+    sprintf(key, "s%d", scene);
+}
+
+/*
+ * Load all stored scenes
+ */
+void scenes_setup()
+{
+    Preferences prefs;
+    char key[8];
+    int num = 0;
+
+    memset(scenes, 0, sizeof(scenes));
+
+    if(!prefs.begin(scNVSName, true))
+        return;
+
+    for(int i = 0; i < SCENE_NUM; i++) {
+        sceneKey(key, i + 1);
+        if(prefs.getBytesLength(key) == sizeof(scenes[i])) {
+            prefs.getBytes(key, &scenes[i], sizeof(scenes[i]));
+            if(scenes[i].version != SC_VERSION || !scenes[i].valid) {
+                scenes[i].valid = 0;
+            } else {
+                num++;
+            }
+        }
+    }
+
+    prefs.end();
+
+    Serial.printf("Scenes: %d stored\n", num);
+}
+
+/*
+ * Get a scene (1-SCENE_NUM); NULL if not stored
+ */
+const sceneData *scenes_get(int scene)
+{
+    if(scene < 1 || scene > SCENE_NUM || !scenes[scene - 1].valid)
+        return NULL;
+
+    return &scenes[scene - 1].sd;
+}
+
+/*
+ * Store a scene (1-SCENE_NUM)
+ * NVS is only written if the scene changed.
+ */
+void scenes_put(int scene, const sceneData *sd)
+{
+    Preferences prefs;
+    char key[8];
+
+    if(scene < 1 || scene > SCENE_NUM)
+        return;
+
+    scene--;
+
+    if(scenes[scene].valid && !memcmp(&scenes[scene].sd, sd, sizeof(*sd)))
+        return;
+
+    scenes[scene].version = SC_VERSION;
+    scenes[scene].valid = 1;
+    memcpy(&scenes[scene].sd, sd, sizeof(*sd));
+
+    if(!prefs.begin(scNVSName))
+        return;
+
+    sceneKey(key, scene + 1);
+    prefs.putBytes(key, &scenes[scene], sizeof(scenes[scene]));
+
+    prefs.end();
+}
+
+#endif  // TC_HAVESCENES
@@ -0,0 +1,27 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _TC_SCENES_H
+#define _TC_SCENES_H
+
+#include "clockdisplay.h"
+#include "speeddisplay.h"
+
+#define SCENE_NUM   16      // Scenes 1-16
+
+struct sceneData {
+    clockImage disp[TC_NUM_DISPLAYS];   // Display index (panel * 3 + display ID)
+    speedImage speedo;
+};
+
+void scenes_setup();
+
+const sceneData *scenes_get(int scene);
+void scenes_put(int scene, const sceneData *sd);
+
+#endif
@@ -16,6 +16,8 @@
 
 #include "tc_settings.h"
 #include "tc_dmx.h" 
+#include "tc_userpers.h"
+#include "tc_cues.h"
 
 static const char *fwfn = "/tcdfw.bin";     //"/tcd-DMX.ino.nodemcu-32s.bin";
 static const char *fwfnold = "/tcdfw.old";  //"/tcd-DMX.ino.nodemcu-32s.old";
@@ -28,7 +30,8 @@ static void unmount_fs();
 /*
  * settings_setup()
  * 
- * Mount SD (if available) and update firmware if available
+ * Mount SD (if available), update firmware if available,
+ * load user personality
  * 
  */
 void settings_setup()
@@ -81,9 +84,15 @@ void settings_setup()
                 delay(5000);
             }
         }
-
-        unmount_fs();
     }
+
+    // Load user personality (from SD, or cached in NVS)
+    userpers_setup(haveSD);
+
+    // Load cue list (from SD only)
+    cues_setup(haveSD);
+
+    unmount_fs();
 }
 
 
@@ -0,0 +1,86 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _TC_STATS_H
+#define _TC_STATS_H
+
+// Manufacturer specific RDM PIDs
+#define TCD_PID_FPS           0x8000  // Frames per second
+#define TCD_PID_DMX_ERRORS    0x8001  // Packet errors by type
+#define TCD_PID_DECODE_TIME   0x8002  // Decode time per display (us; last, max)
+#define TCD_PID_BUS_TIME      0x8003  // Bus time per display (us; last, max)
+#define TCD_PID_I2C_ERRORS    0x8004  // I2C errors (NACKs, timeouts)
+#define TCD_PID_LOOP_STATS    0x8005  // Loop overruns, max loop time (us)
+#define TCD_PID_RTC_TEMP      0x8006  // RTC temperature (1/100 deg C)
+#define TCD_PID_UPTIME        0x8007  // Uptime (seconds)
+#define TCD_PID_BUS_UTIL      0x8008  // Display update time per I2C bus (1/100 percent)
+#define TCD_PID_RX_STATS      0x8009  // Receive ISR time (ns, max; 1/100 percent), latency (us; last, max)
+#define TCD_PID_TASK_STATS    0x800a  // Per loop task: Max run time (us), budget overruns, deadline misses
+#define TCD_PID_I2C_TRAFFIC   0x800b  // I2C bytes, transactions per loop pass (last, max); budget overruns
+
+#define STATS_NUM_ERRTYPES    8
+#define STATS_NUM_DISPLAYS    4       // DT, PT, LT, Speedo (see below)
+#define STATS_NUM_BUSES       2       // Wire, Wire1
+#define STATS_NUM_TASKS       5       // Receive, Blink, Effects, Render, Housekeeping
+
+#define STATS_FRAME_US    22700       // Loop time considered an overrun (one DMX frame)
+
+// I2C traffic budget per loop pass (bytes, including address bytes):
+// A full update of every display, RTC reads, multiplexer switches.
+// Also the default budget per frame of tools/replay.cpp.
+#define I2C_BUDGET_DISPLAY      24
+#define I2C_BUDGET_RTC          40
+#define I2C_BUDGET_PASS  ((TC_NUM_DISPLAYS + 1) * I2C_BUDGET_DISPLAY + I2C_BUDGET_RTC + TC_NUM_PANELS * 2)
+
+/*
+ * Runtime statistics
+ *
+ * Written by the DMX loop only; each member is a naturally aligned 32bit
+ * word, so readers (RDM) see consistent values without locking.
+ * Members are grouped in the order of the RDM parameters' data.
+ *
+ * Decode and bus times are per display position: With several panels,
+ * "last" is that of the position's most recently updated display (on
+ * any panel), "max" the maximum over all panels.
+ */
+struct tcStats {
+    uint32_t fps;
+    uint32_t frames;
+    uint32_t dmxErrors[STATS_NUM_ERRTYPES];
+    uint32_t decodeTime[STATS_NUM_DISPLAYS];
+    uint32_t decodeTimeMax[STATS_NUM_DISPLAYS];
+    uint32_t busTime[STATS_NUM_DISPLAYS];
+    uint32_t busTimeMax[STATS_NUM_DISPLAYS];
+    uint32_t i2cErrors;
+    uint32_t loopOverruns;
+    uint32_t loopTimeMax;
+    int32_t  rtcTemp;
+    uint32_t uptime;
+    uint32_t busUtil[STATS_NUM_BUSES];
+    uint32_t rxIsrMax;
+    uint32_t rxIsrLoad;
+    uint32_t rxLatency;
+    uint32_t rxLatencyMax;
+    uint32_t taskTimeMax[STATS_NUM_TASKS];
+    uint32_t taskOverruns[STATS_NUM_TASKS];
+    uint32_t taskMisses[STATS_NUM_TASKS];
+    uint32_t i2cBytes;
+    uint32_t i2cBytesMax;
+    uint32_t i2cTransactions;
+    uint32_t i2cTransactionsMax;
+    uint32_t i2cBudgetOverruns;
+    // Blink phase lock (TC_BLINK_LOCK): Not an RDM parameter, as the
+    // lock requires the lean receiver; logged instead
+    int32_t  blinkPhaseErr;
+    uint32_t blinkPhaseErrMax;
+    uint32_t blinkLocked;
+} __attribute__((aligned(32)));
+
+extern tcStats stats;
+
+#endif
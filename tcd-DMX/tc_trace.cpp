@@ -0,0 +1,108 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Timeline trace
+ *
+ * Begin/end events of the render pipeline are stored in a ring
+ * buffer in RAM, tagged with the CPU's cycle counter and core; the
+ * ring always holds the latest TRACE_RING_SIZE events. Sending
+ * TRACE_DUMP_CMD on Serial dumps the ring (and clears it); Serial
+ * input is reserved for this, any other byte is discarded. The host
+ * replay (tools/replay.cpp) calls trace_dump() directly.
+ * tools/trace2json.cpp converts the dump into Chrome trace JSON.
+ * -------------------------------------------------------------------
+ */
+
+#include "tc_global.h"
+
+#ifdef TC_TRACE
+
+#include <Arduino.h>
+#include <atomic>
+#include <hal/cpu_hal.h>
+
+#include "tc_trace.h"
+
+#define TRACE_RING_SIZE 2048    // Must be a power of 2
+#define TRACE_DUMP_CMD   't'
+
+struct traceEntry {
+    uint32_t cycles;
+    uint8_t  id;                // Event ID | core << 7
+    char     phase;
+    uint16_t arg;
+};
+
+static traceEntry            traceRing[TRACE_RING_SIZE];
+static std::atomic<uint32_t> traceHead(0);
+static volatile bool         tracePaused = false;
+
+static const char *traceNames[TR_NUM_IDS] = {
+    "Receive",
+    "Decode",
+    "Render",
+    "I2C",
+    "SQW"
+};
+
+/*
+ * Store an event; safe to be called from any task, never blocks
+ */
+void TC_IRAM trace_event(uint8_t id, char phase, uint16_t arg)
+{
+    traceEntry *e;
+
+    if(tracePaused)
+        return;
+
+    e = &traceRing[traceHead.fetch_add(1, std::memory_order_relaxed) & (TRACE_RING_SIZE - 1)];
+    e->cycles = cpu_hal_get_cycle_count();
+    e->id = id | (xPortGetCoreID() << 7);
+    e->phase = phase;
+    e->arg = arg;
+}
+
+/*
+ * Dump the ring on Serial, and clear it. Output:
+ * trace,begin,<CPU MHz>,<number of events>
+ * trace,<cycles>,<core>,<event>,<phase>,<arg>
+ * ...
+ * trace,end
+ * Recording is paused while dumping.
+ */
+void trace_dump()
+{
+    uint32_t head, num;
+
+    tracePaused = true;
+
+    head = traceHead.load();
+    num = min(head, (uint32_t)TRACE_RING_SIZE);
+
+    Serial.printf("trace,begin,%lu,%lu\n", (unsigned long)ESP.getCpuFreqMHz(), (unsigned long)num);
+    for(uint32_t i = head - num; i != head; i++) {
+        const traceEntry& e = traceRing[i & (TRACE_RING_SIZE - 1)];
+        Serial.printf("trace,%lu,%d,%s,%c,%u\n", (unsigned long)e.cycles, e.id >> 7,
+                      traceNames[e.id & 0x7f], e.phase, e.arg);
+    }
+    Serial.println("trace,end");
+
+    traceHead.store(0);
+    tracePaused = false;
+}
+
+/*
+ * Dump the ring if asked for on Serial (other input is discarded)
+ */
+void trace_poll()
+{
+    if(Serial.available() && Serial.read() == TRACE_DUMP_CMD) {
+        trace_dump();
+    }
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _TC_TRACE_H
+#define _TC_TRACE_H
+
+// Trace event IDs
+enum {
+    TR_RECEIVE = 0,             // Read and decode a packet
+    TR_DECODE,                  // arg = display index
+    TR_RENDER,                  // Show displays; arg = bitmask of displays (low 16 bits)
+    TR_I2C,                     // Bus transaction; arg = I2C address (begin), TR_I2C_ARG (end)
+    TR_SQW,                     // 1Hz signal edge; arg = level
+    TR_NUM_IDS
+};
+
+// I2C end event: Address, bus, number of bytes written (without the
+// address byte); with rd, one register byte is written and len bytes
+// are read in a second transaction
+#define TR_I2C_ARG(addr, bus, len, rd) \
+            ((addr) | ((bus) << 7) | (((len) & 0x7f) << 8) | ((rd) << 15))
+
+// Phases
+#define TR_BEGIN    'B'
+#define TR_END      'E'
+#define TR_INSTANT  'i'
+
+#ifdef TC_TRACE
+
+void trace_event(uint8_t id, char phase, uint16_t arg);
+void trace_poll();
+void trace_dump();
+
+#define TRACE_BEGIN(id, arg)    trace_event((id), TR_BEGIN, (arg))
+#define TRACE_END(id, arg)      trace_event((id), TR_END, (arg))
+#define TRACE_INSTANT(id, arg)  trace_event((id), TR_INSTANT, (arg))
+
+#else
+
+#define TRACE_BEGIN(id, arg)
+#define TRACE_END(id, arg)
+#define TRACE_INSTANT(id, arg)
+
+#endif
+
+#endif
@@ -0,0 +1,459 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * User personality
+ *
+ * A personality file on the SD card (/personality.txt) replaces the
+ * built-in channel layout. It is compiled at boot into a mapping
+ * program (slot -> curve -> field) and cached in NVS, so the SD card
+ * is only needed to change it.
+ *
+ * File format: One channel per line, '#' starts a comment
+ *
+ *   footprint <n>                          (optional)
+ *   <slot> <display> <field> [<value>=<output> ...]
+ *
+ * slot:    1-512, relative to the DMX start address
+ * display: DT, PT, LT
+ * field:   Month, Day, Y1000, Y100, Y10, Y1, Hour, Min, AMPM, Colon,
+ *          Intensity, Mode, Rate
+ * Without <value>=<output> pairs, the field's built-in value ranges
+ * are used. Otherwise, the output is <output> for all channel values
+ * from <value> up to the next pair's <value> (0 below the first pair).
+ * Outputs are as decoded by the built-in personality (see the PF_xxx
+ * field types in tc_personality.h).
+ *
+ * Fields not mapped to any slot keep their default (blank, AM, colon
+ * off, full brightness, DMX mode, real time rate).
+ * -------------------------------------------------------------------
+ */
+
+#include "tc_global.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FS.h>
+#include <Preferences.h>
+
+#include "tc_userpers.h"
+
+#define UP_MAGIC        0x50444354      // "TCDP"
+#define UP_VERSION      1
+#define UP_MAX_OPS      64
+#define UP_MAX_CURVES   16
+#define UP_MAX_SLOTS    512
+#define UP_MAX_LINE     256
+
+static const char *upfn = "/personality.txt";
+static const char *upNVSName = "tcdpers";
+static const char *upNVSKey  = "prog";
+
+struct upOp {
+    uint16_t slot;          // Relative to start address (0-based)
+    uint8_t  dest;          // display * UP_FIELDS + field
+    uint8_t  curve;
+};
+
+// The program; stored in NVS up to and including the used curves
+static struct upProg {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t footprint;
+    uint16_t numOps;
+    uint16_t numCurves;
+    uint32_t hash;          // Of source file
+    upOp     ops[UP_MAX_OPS];
+    uint8_t  curves[UP_MAX_CURVES][256];
+} prog;
+
+#define UP_PROG_SIZE(n) (offsetof(upProg, curves) + (n) * 256)
+#define UP_HDR_SIZE     offsetof(upProg, ops)
+
+static bool active = false;
+static int  maxSlot = 0;
+
+static const uint8_t upDefaults[UP_FIELDS] = {
+    0, 0, 0, 0, 0, 0, 0, 0,     // Date/time blank
+    1,                          // AM
+    0,                          // Colon off
+    16,                         // Full brightness
+    0,                          // Mode: DMX
+    128                         // Rate: real time
+};
+
+static const uint8_t upFieldMax[UP_FIELDS] = {
+    12, 31, 10, 10, 10, 10, 13, 60, 1, 2, 16, 255, 255
+};
+
+static bool loadNVS();
+static void saveNVS();
+static void clearNVS();
+
+/*
+ * Compiler
+ */
+
+static void builtinCurve(int field, uint8_t *curve)
+{
+    uint8_t src[PERS_DISPLAY_SLOTS], out[PF_NUM];
+
+    for(int v = 0; v < 256; v++) {
+        if(field == PF_MODE) {
+            curve[v] = persDecodeGlobal<PG_MODE>(v);
+        } else if(field == PF_RATE) {
+            curve[v] = v;
+        } else {
+            memset(src, v, sizeof(src));
+            persDecode(src, out);
+            curve[v] = out[field];
+        }
+    }
+}
+
+static int addCurve(const uint8_t *curve)
+{
+    for(int i = 0; i < prog.numCurves; i++) {
+        if(!memcmp(prog.curves[i], curve, 256))
+            return i;
+    }
+
+    if(prog.numCurves >= UP_MAX_CURVES)
+        return -1;
+
+    memcpy(prog.curves[prog.numCurves], curve, 256);
+
+    return prog.numCurves++;
+}
+
+static int findField(const char *name)
+{
+    for(int i = 0; i < PERS_DISPLAY_SLOTS; i++) {
+        if(!strcasecmp(name, persDisplayFields[i].name))
+            return persDisplayFields[i].type;
+    }
+    for(int i = 0; i < PERS_GLOBAL_FIELDS; i++) {
+        if(!strcasecmp(name, persGlobalFields[i].name))
+            return persGlobalFields[i].type;
+    }
+
+    return -1;
+}
+
+static int findDisplay(const char *name)
+{
+    for(int i = 0; i < PERS_NUM_DISPLAYS; i++) {
+        if(!strcasecmp(name, persDisplayNames[i]))
+            return i;
+    }
+
+    return -1;
+}
+
+static bool compileError(int lineNo, const char *msg, const char *token)
+{
+    Serial.printf("%s line %d: %s (%s)\n", upfn, lineNo, msg, token ? token : "");
+
+    return false;
+}
+
+static bool compileLine(char *line, int lineNo)
+{
+    uint8_t curve[256];
+    char *tok, *t;
+    int slot, did, field, c, v, lastv = -1, out = 0;
+
+    if((t = strchr(line, '#'))) *t = 0;
+
+    if(!(tok = strtok(line, " \t")))
+        return true;
+
+    if(!strcasecmp(tok, "footprint")) {
+        if(!(tok = strtok(NULL, " \t")) || (v = atoi(tok)) < 1 || v > UP_MAX_SLOTS)
+            return compileError(lineNo, "Bad footprint", tok);
+        prog.footprint = v;
+        return true;
+    }
+
+    slot = atoi(tok);
+    if(slot < 1 || slot > UP_MAX_SLOTS)
+        return compileError(lineNo, "Bad slot", tok);
+
+    if(!(tok = strtok(NULL, " \t")) || (did = findDisplay(tok)) < 0)
+        return compileError(lineNo, "Bad display", tok);
+
+    if(!(tok = strtok(NULL, " \t")) || (field = findField(tok)) < 0)
+        return compileError(lineNo, "Bad field", tok);
+
+    if(!(tok = strtok(NULL, " \t"))) {
+        builtinCurve(field, curve);
+    } else {
+        memset(curve, 0, 256);
+        do {
+            if(!(t = strchr(tok, '=')))
+                return compileError(lineNo, "Expected <value>=<output>", tok);
+            v = atoi(tok);
+            if(v <= lastv || v > 255)
+                return compileError(lineNo, "Values must be ascending, 0-255", tok);
+            out = atoi(t + 1);
+            if(out < 0 || out > upFieldMax[field])
+                return compileError(lineNo, "Output out of range", tok);
+            memset(curve + v, out, 256 - v);
+            lastv = v;
+        } while((tok = strtok(NULL, " \t")));
+    }
+
+    if(prog.numOps >= UP_MAX_OPS)
+        return compileError(lineNo, "Too many channels", NULL);
+
+    if((c = addCurve(curve)) < 0)
+        return compileError(lineNo, "Too many different value ranges", NULL);
+
+    prog.ops[prog.numOps].slot = slot - 1;
+    prog.ops[prog.numOps].dest = did * UP_FIELDS + field;
+    prog.ops[prog.numOps].curve = c;
+    prog.numOps++;
+
+    if(slot > maxSlot) maxSlot = slot;
+
+    return true;
+}
+
+static void compileStart()
+{
+    memset(&prog, 0, sizeof(prog));
+    prog.magic = UP_MAGIC;
+    prog.version = UP_VERSION;
+    maxSlot = 0;
+}
+
+static bool compileEnd()
+{
+    if(!prog.numOps) {
+        Serial.printf("%s: No channels defined\n", upfn);
+        return false;
+    }
+
+    if(!prog.footprint) {
+        prog.footprint = maxSlot;
+    } else if(prog.footprint < maxSlot) {
+        Serial.printf("%s: Footprint %d too small for slot %d\n", upfn, prog.footprint, maxSlot);
+        return false;
+    }
+
+    return true;
+}
+
+static bool compileFile()
+{
+    char line[UP_MAX_LINE];
+    int len = 0, lineNo = 1, c;
+    bool ok = true;
+    uint32_t hash = 2166136261UL;   // FNV-1a
+
+    File myFile = SD.open(upfn, FILE_READ);
+
+    if(!myFile) {
+        Serial.printf("Failed to open %s\n", upfn);
+        return false;
+    }
+
+    compileStart();
+
+    do {
+        c = myFile.read();
+        if(c >= 0) {
+            hash = (hash ^ (uint8_t)c) * 16777619UL;
+        }
+        if(c < 0 || c == '\n') {
+            line[len] = 0;
+            if(!compileLine(line, lineNo)) {
+                ok = false;
+                break;
+            }
+            len = 0;
+            lineNo++;
+        } else if(c != '\r' && len < UP_MAX_LINE - 1) {
+            line[len++] = c;
+        }
+    } while(c >= 0);
+
+    myFile.close();
+
+    if(ok) ok = compileEnd();
+
+    prog.hash = hash;
+
+    return ok;
+}
+
+/*
+ * userpers_setup()
+ *
+ * Compile personality file from SD, if available; otherwise
+ * use the cached program from NVS.
+ * Must be called while SD is mounted.
+ */
+void userpers_setup(bool haveSD)
+{
+    active = false;
+
+    if(haveSD && SD.exists(upfn)) {
+        if(compileFile()) {
+            active = true;
+            saveNVS();
+        } else {
+            // Don't fall back to an older program from the cache,
+            // neither now nor when booting without SD
+            Serial.println("Personality file not usable, using built-in personality");
+            clearNVS();
+        }
+    } else if(haveSD) {
+        // SD present, but no file: Revert to built-in personality
+        clearNVS();
+    } else {
+        active = loadNVS();
+    }
+
+    if(active) {
+        Serial.printf("Using user personality: %d channels, footprint %d\n", prog.numOps, prog.footprint);
+    }
+}
+
+bool userpers_active()
+{
+    return active;
+}
+
+int userpers_footprint()
+{
+    return prog.footprint;
+}
+
+// Program not usable in this configuration: Use built-in personality
+void userpers_reject()
+{
+    active = false;
+}
+
+/*
+ * Interpreter
+ *
+ * src:  Slots, starting at the DMX start address
+ * out:  PERS_NUM_DISPLAYS * UP_FIELDS values
+ */
+void userpers_run(const uint8_t *src, uint8_t *out)
+{
+    const upOp *op = prog.ops;
+    const upOp *end = op + prog.numOps;
+
+    for(int i = 0; i < PERS_NUM_DISPLAYS; i++) {
+        memcpy(out + i * UP_FIELDS, upDefaults, UP_FIELDS);
+    }
+
+    while(op < end) {
+        out[op->dest] = prog.curves[op->curve][src[op->slot]];
+        op++;
+    }
+}
+
+/*
+ * NVS cache
+ */
+
+static bool loadNVS()
+{
+    Preferences prefs;
+    size_t size;
+    bool ret = false;
+
+    if(!prefs.begin(upNVSName, true))
+        return false;
+
+    size = prefs.getBytesLength(upNVSKey);
+
+    if(size >= UP_PROG_SIZE(0) && size <= sizeof(prog)) {
+        prefs.getBytes(upNVSKey, &prog, size);
+        if(prog.magic == UP_MAGIC && prog.version == UP_VERSION &&
+           prog.numOps <= UP_MAX_OPS && prog.numCurves <= UP_MAX_CURVES &&
+           size == UP_PROG_SIZE(prog.numCurves)) {
+            ret = true;
+            for(int i = 0; i < prog.numOps; i++) {
+                if(prog.ops[i].slot >= prog.footprint ||
+                   prog.ops[i].dest >= PERS_NUM_DISPLAYS * UP_FIELDS ||
+                   prog.ops[i].curve >= prog.numCurves) {
+                    ret = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    prefs.end();
+
+    return ret;
+}
+
+static void saveNVS()
+{
+    Preferences prefs;
+    uint8_t hdr[UP_HDR_SIZE];
+
+    if(!prefs.begin(upNVSName))
+        return;
+
+    // Skip writing if unchanged (same header, including source hash)
+    if(prefs.getBytesLength(upNVSKey) == UP_PROG_SIZE(prog.numCurves)) {
+        prefs.getBytes(upNVSKey, hdr, sizeof(hdr));
+        if(!memcmp(hdr, &prog, sizeof(hdr))) {
+            prefs.end();
+            return;
+        }
+    }
+
+    prefs.putBytes(upNVSKey, &prog, UP_PROG_SIZE(prog.numCurves));
+
+    prefs.end();
+}
+
+static void clearNVS()
+{
+    Preferences prefs;
+
+    if(prefs.begin(upNVSName)) {
+        prefs.remove(upNVSKey);
+        prefs.end();
+    }
+}
+
+#ifdef TC_BENCH
+/*
+ * Compile the built-in layout, for comparing the interpreter
+ * with the built-in decoder
+ */
+bool userpers_bench_builtin()
+{
+    char line[64];
+    int slot = 1;
+
+    compileStart();
+
+    for(int d = 0; d < PERS_NUM_DISPLAYS; d++) {
+        for(int i = 0; i < PERS_DISPLAY_SLOTS; i++) {
+            snprintf(line, sizeof(line), "%d %s %s", slot++, persDisplayNames[d], persDisplayFields[i].name);
+            if(!compileLine(line, 0)) return false;
+        }
+    }
+    for(int i = 0; i < PERS_GLOBAL_FIELDS; i++) {
+        for(int d = 0; d < PERS_NUM_DISPLAYS; d++) {
+            snprintf(line, sizeof(line), "%d %s %s", slot++, persDisplayNames[d], persGlobalFields[i].name);
+            if(!compileLine(line, 0)) return false;
+        }
+    }
+
+    return compileEnd();
+}
+#endif
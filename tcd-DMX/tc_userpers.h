@@ -0,0 +1,29 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _TC_USERPERS_H
+#define _TC_USERPERS_H
+
+#include "tc_personality.h"
+
+// Decoded values per display: PF_xxx, plus mode and rate
+#define UP_FIELDS   (PF_RATE + 1)
+
+void userpers_setup(bool haveSD);
+
+bool userpers_active();
+int  userpers_footprint();
+void userpers_reject();
+
+void userpers_run(const uint8_t *src, uint8_t *out);
+
+#ifdef TC_BENCH
+bool userpers_bench_builtin();
+#endif
+
+#endif
@@ -71,6 +71,10 @@
 
 #include "tc_settings.h"
 #include "tc_dmx.h"
+#include "tc_log.h"
+#ifdef TC_BENCH
+#include "tc_bench.h"
+#endif
 
 void setup()
 {
@@ -79,18 +83,42 @@ void setup()
     Serial.begin(115200);
     Serial.println();
 
+    log_setup();
+
+    #ifdef TC_BENCH
+    bench_run();
+    #endif
+
     // I2C init
     // Make sure our i2c buf is 128 bytes
     Wire.setBufferSize(128);
-    // PCF8574 only supports 100kHz, can't go to 400 here.
-    Wire.begin(-1, -1, 100000);
+    // PCF8574 only supports 100kHz; see TC_I2C_CLOCK.
+    Wire.begin(-1, -1, TC_I2C_CLOCK);
+    #ifdef TC_I2C_SPLIT
+    Wire1.setBufferSize(128);
+    Wire1.begin(I2C1_SDA_PIN, I2C1_SCL_PIN, TC_I2C_CLOCK);
+    #endif
 
     dmx_boot();
+
+    #ifdef TC_BENCH
+    bench_bus();
+    #endif
+
     settings_setup();
     dmx_setup();
+
+    #ifdef TC_DMX_TASK
+    dmx_start_tasks();
+    #endif
 }
 
 void loop()
 {
+    #ifdef TC_DMX_TASK
+    // Everything runs in the DMX task
+    vTaskDelete(NULL);
+    #else
     dmx_loop();
+    #endif
 }
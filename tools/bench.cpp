@@ -0,0 +1,66 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Micro benchmarks on the host
+ *
+ * Runs the firmware's benchmarks (tcd-DMX/tc_bench.cpp, unmodified)
+ * on the host, in the firmware's order: bench_run() first, then the
+ * displays are set up as at boot, then bench_bus() runs against the
+ * emulated I2C bus (tools/host/host.cpp). The CSV lines are written
+ * to stdout; the firmware's other Serial output (display setup) goes
+ * to stderr.
+ *
+ * The cycle counter runs at a nominal 240MHz, on the emulated time
+ * plus the host's own run time (clock_gettime()). So "ns/op" is the
+ * host's time for code that does not touch the bus, and the emulated
+ * bus time (at the bus clock, no gaps) plus the host's time for the
+ * bus benchmarks. Host and ESP32 times are not comparable; compare
+ * runs on the same host, e.g. before and after a change.
+ *
+ * Build and run on the host (from the repository's top directory),
+ * with the same build options as the firmware (tcd-DMX/tc_global.h,
+ * or -D on the command line), plus TC_BENCH:
+ *
+ * g++ -std=gnu++11 -O2 -DTC_BENCH -Itools/host -Itcd-DMX -o bench \
+ *     tools/bench.cpp tools/host/host.cpp tcd-DMX/tc_bench.cpp \
+ *     tcd-DMX/tc_dmx.cpp tcd-DMX/clockdisplay.cpp tcd-DMX/speeddisplay.cpp \
+ *     tcd-DMX/rtc.cpp tcd-DMX/tc_log.cpp tcd-DMX/tc_userpers.cpp \
+ *     tcd-DMX/tc_cues.cpp tcd-DMX/tc_scenes.cpp tcd-DMX/tc_trace.cpp
+ *
+ * ./bench > bench.csv
+ * -------------------------------------------------------------------
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#include "tc_global.h"
+#include "tc_dmx.h"
+#include "tc_bench.h"
+#include "host.h"
+
+#ifndef TC_BENCH
+#error "Build the benchmarks with TC_BENCH"
+#endif
+
+int main(int argc, char *argv[])
+{
+    hostCpuTime = true;
+
+    hostSerial = stdout;
+    bench_run();
+
+    hostSerial = stderr;
+    hostRtcSetup();
+    Wire.begin(-1, -1, TC_I2C_CLOCK);
+    dmx_boot();
+
+    hostSerial = stdout;
+    bench_bus();
+
+    return 0;
+}
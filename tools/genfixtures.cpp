@@ -0,0 +1,227 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Fixture definition generator
+ *
+ * Generates the QLC+ fixture definition and the README's channel
+ * tables from the DMX personalities in tcd-DMX/tc_personality.h.
+ *
+ * Build and run on the host (from the repository's top directory):
+ *
+ * g++ -std=c++11 -o genfixtures tools/genfixtures.cpp
+ * ./genfixtures qxf > Fixture-Defs/CircuitSetup-TCD.qxf
+ * ./genfixtures readme [personality]
+ *
+ * The output of "readme" (personality 1, the default) replaces the
+ * table in README.md's "DMX channels" section, the output of
+ * "readme 2" the table in the "16-bit personality" section, the
+ * output of "readme 3" the one in the "Raw segment personality"
+ * section.
+ * -------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../tcd-DMX/tc_personality.h"
+
+#define DMX_ADDRESS 1
+
+struct capRange {
+    int min, max;
+    char label[64];
+};
+
+/*
+ * Collect a field's capabilities (value ranges)
+ */
+static int getCaps(const persField& f, capRange *caps)
+{
+    int num = 0;
+
+    if(f.caps && f.map != PM_TABLE && f.map != PM_DIV) {
+        int min = 0;
+        for(int i = 0; i < f.numCaps; i++) {
+            caps[num].min = min;
+            caps[num].max = f.caps[i].max;
+            snprintf(caps[num].label, sizeof(caps[num].label), "%s", f.caps[i].label);
+            min = f.caps[i].max + 1;
+            num++;
+        }
+        return num;
+    }
+
+    if(f.map == PM_TABLE || f.map == PM_DIV) {
+        int last = -1;
+        for(int v = 0; v < 256; v++) {
+            int out = (f.map == PM_TABLE) ? persTables[f.param][v] : v / f.param;
+            if(out != last) {
+                caps[num].min = v;
+                if(!out) {
+                    snprintf(caps[num].label, sizeof(caps[num].label), "Blank");
+                } else {
+                    snprintf(caps[num].label, sizeof(caps[num].label), f.capFmt, out + f.capOffs);
+                }
+                num++;
+                last = out;
+            }
+            caps[num - 1].max = v;
+        }
+        return num;
+    }
+
+    caps[0].min = 0;
+    caps[0].max = 255;
+    snprintf(caps[0].label, sizeof(caps[0].label), "%s", f.desc);
+
+    return 1;
+}
+
+static void printChannel(const char *disp, const persField& f)
+{
+    capRange caps[256];
+    int num = getCaps(f, caps);
+
+    printf(" <Channel Name=\"%s-%s\">\n", disp, f.name);
+    printf("  <Group Byte=\"%d\">%s</Group>\n", (f.map == PM_FINE) ? 1 : 0, f.group);
+    for(int i = 0; i < num; i++) {
+        printf("  <Capability Min=\"%d\" Max=\"%d\">%s</Capability>\n", caps[i].min, caps[i].max, caps[i].label);
+    }
+    printf(" </Channel>\n");
+}
+
+// Channels of later personalities with the same name are the same
+static bool isNewChannel(int p, int i)
+{
+    for(int q = 0; q <= p; q++) {
+        for(int j = 0; j < ((q < p) ? persPersonalities[q].numFields : i); j++) {
+            if(!strcmp(persPersonalities[q].fields[j].name, persPersonalities[p].fields[i].name))
+                return false;
+        }
+    }
+    return true;
+}
+
+static void genQXF()
+{
+    printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    printf("<!DOCTYPE FixtureDefinition>\n");
+    printf("<FixtureDefinition xmlns=\"http://www.qlcplus.org/FixtureDefinition\">\n");
+    printf(" <Creator>\n");
+    printf("  <Name>Q Light Controller Plus</Name>\n");
+    printf("  <Version>4.12.7</Version>\n");
+    printf("  <Author>Thomas Winischhofer</Author>\n");
+    printf(" </Creator>\n");
+    printf(" <Manufacturer>CircuitSetup</Manufacturer>\n");
+    printf(" <Model>TCD</Model>\n");
+    printf(" <Type>Other</Type>\n");
+
+    for(int d = 0; d < PERS_NUM_DISPLAYS; d++) {
+        for(int p = 0; p < PERS_NUM; p++) {
+            for(int i = 0; i < persPersonalities[p].numFields; i++) {
+                if(isNewChannel(p, i)) {
+                    printChannel(persDisplayNames[d], persPersonalities[p].fields[i]);
+                }
+            }
+        }
+    }
+    for(int i = 0; i < PERS_GLOBAL_FIELDS; i++) {
+        for(int d = 0; d < PERS_NUM_DISPLAYS; d++) {
+            printChannel(persDisplayNames[d], persGlobalFields[i]);
+        }
+    }
+
+    for(int p = 0; p < PERS_NUM; p++) {
+        const persDesc& pd = persPersonalities[p];
+        int slot = 0;
+
+        printf(" <Mode Name=\"%s\">\n", pd.name);
+        for(int d = 0; d < PERS_NUM_DISPLAYS; d++) {
+            for(int i = 0; i < pd.numFields; i++) {
+                printf("  <Channel Number=\"%d\">%s-%s</Channel>\n", slot++, persDisplayNames[d], pd.fields[i].name);
+            }
+        }
+        for(int i = 0; i < pd.numGlobals; i++) {
+            for(int d = 0; d < PERS_NUM_DISPLAYS; d++) {
+                printf("  <Channel Number=\"%d\">%s-%s</Channel>\n", slot++, persDisplayNames[d], persGlobalFields[i].name);
+            }
+        }
+        printf(" </Mode>\n");
+    }
+
+    printf(" <Physical>\n");
+    printf("  <Bulb Type=\"LED\" Lumens=\"0\" ColourTemperature=\"0\"/>\n");
+    printf("  <Dimensions Weight=\"0\" Width=\"0\" Height=\"0\" Depth=\"0\"/>\n");
+    printf("  <Lens Name=\"Other\" DegreesMin=\"0\" DegreesMax=\"0\"/>\n");
+    printf("  <Focus Type=\"Fixed\" PanMax=\"0\" TiltMax=\"0\"/>\n");
+    printf("  <Technical PowerConsumption=\"5\" DmxConnector=\"3-pin\"/>\n");
+    printf(" </Physical>\n");
+    printf("</FixtureDefinition>\n");
+}
+
+static void printRow(int chnl, const char *disp, const persField& f)
+{
+    printf("    <tr><td>%d</td><td>%s: %s", chnl, disp, f.desc);
+
+    if(f.flags & PFL_DOC_CAPS) {
+        capRange caps[256];
+        int num = getCaps(f, caps);
+        printf(" (");
+        for(int i = 0; i < num; i++) {
+            if(caps[i].min == caps[i].max) {
+                printf("%s%d=%s", i ? "; " : "", caps[i].min, caps[i].label);
+            } else {
+                printf("%s%d-%d=%s", i ? "; " : "", caps[i].min, caps[i].max, caps[i].label);
+            }
+        }
+        printf(")");
+    } else if(f.flags & PFL_DOC_BELOW) {
+        printf(" (see below)");
+    }
+
+    printf("</td></tr>\n");
+}
+
+static void genREADME(int p)
+{
+    const persDesc& pd = persPersonalities[p];
+    int chnl = DMX_ADDRESS;
+
+    printf("<table>\n");
+    printf("    <tr><td>DMX channel</td><td>Function</td></tr>\n");
+    for(int d = 0; d < PERS_NUM_DISPLAYS; d++) {
+        for(int i = 0; i < pd.numFields; i++) {
+            printRow(chnl++, persDisplayDesc[d], pd.fields[i]);
+        }
+    }
+    for(int i = 0; i < pd.numGlobals; i++) {
+        for(int d = 0; d < PERS_NUM_DISPLAYS; d++) {
+            printRow(chnl++, persDisplayDesc[d], persGlobalFields[i]);
+        }
+    }
+    printf("</table>\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc == 2 && !strcmp(argv[1], "qxf")) {
+        genQXF();
+    } else if((argc == 2 || argc == 3) && !strcmp(argv[1], "readme")) {
+        int p = (argc == 3) ? atoi(argv[2]) : 1;
+        if(p < 1 || p > PERS_NUM) {
+            fprintf(stderr, "Personality must be 1-%d\n", PERS_NUM);
+            return 1;
+        }
+        genREADME(p - 1);
+    } else {
+        fprintf(stderr, "Usage: %s qxf|readme [personality]\n", argv[0]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host build of the firmware (tools/replay.cpp, tools/bench.cpp):
+ * Arduino core and FreeRTOS, as far as the firmware uses them. Time,
+ * pins, timers and the I2C bus are emulated in tools/host/host.cpp;
+ * tasks are not run.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _HOST_ARDUINO_H
+#define _HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+
+#define F(x) x
+
+#define B11111000 0xf8
+#define B00000110 0x06
+#define B11100011 0xe3
+#define B11011111 0xdf
+#define B00100000 0x20
+
+#define INPUT           1
+#define OUTPUT          2
+#define INPUT_PULLDOWN  3
+#define INPUT_PULLUP    4
+#define HIGH            1
+#define LOW             0
+#define RISING          1
+#define FALLING         2
+#define CHANGE          3
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+
+// FreeRTOS: One tick is 1ms
+#define portMAX_DELAY        0xffffffff
+#define pdMS_TO_TICKS(x)     (x)
+#define pdTRUE               1
+#define pdFALSE              0
+#define pdPASS               1
+#define ARDUINO_RUNNING_CORE 1
+
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void    *TaskHandle_t;
+typedef void    *SemaphoreHandle_t;
+typedef struct { int owner; } portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+
+inline void portENTER_CRITICAL(portMUX_TYPE *) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE *) {}
+inline void portENTER_CRITICAL_ISR(portMUX_TYPE *) {}
+inline void portEXIT_CRITICAL_ISR(portMUX_TYPE *) {}
+inline void portYIELD_FROM_ISR() {}
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*)(void *), const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *, BaseType_t) { return pdPASS; }
+inline BaseType_t xTaskCreate(void (*)(void *), const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *) { return pdPASS; }
+inline void       vTaskDelete(TaskHandle_t) {}
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return NULL; }
+inline BaseType_t xPortGetCoreID() { return 1; }
+inline uint32_t   ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+inline BaseType_t xTaskNotifyGive(TaskHandle_t) { return pdPASS; }
+inline void       vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t *) {}
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return NULL; }
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return NULL; }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t, BaseType_t *) { return pdTRUE; }
+
+void       vTaskDelay(TickType_t ticks);
+void       vTaskDelayUntil(TickType_t *last, TickType_t ticks);
+TickType_t xTaskGetTickCount();
+
+// Time, pins, timers
+unsigned long millis();
+unsigned long micros();
+int64_t  esp_timer_get_time();
+void     delay(unsigned long ms);
+void     delayMicroseconds(unsigned int us);
+
+void     pinMode(int pin, int mode);
+int      digitalRead(int pin);
+void     digitalWrite(int pin, int val);
+int      digitalPinToInterrupt(int pin);
+void     attachInterrupt(int irq, void (*isr)(), int mode);
+
+typedef struct hw_timer_s hw_timer_t;
+hw_timer_t *timerBegin(uint8_t num, uint16_t divider, bool countUp);
+void     timerAttachInterrupt(hw_timer_t *timer, void (*isr)(), bool edge);
+void     timerAlarmWrite(hw_timer_t *timer, uint64_t alarm, bool autoReload);
+void     timerAlarmEnable(hw_timer_t *timer);
+void     timerAlarmDisable(hw_timer_t *timer);
+
+uint32_t esp_random();
+
+typedef enum {
+    ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC,
+    ESP_RST_INT_WDT, ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT, ESP_RST_SDIO
+} esp_reset_reason_t;
+esp_reset_reason_t esp_reset_reason();
+
+class String {
+    public:
+        String(const char *s = "") { snprintf(_s, sizeof(_s), "%s", s); }
+        const char *c_str() const { return _s; }
+    private:
+        char _s[128];
+};
+
+class Print {
+    public:
+        size_t write(uint8_t c);
+        size_t write(const uint8_t *buf, size_t len);
+        int    printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+        size_t print(const char *s);
+        size_t print(int v);
+        size_t println(const char *s = "");
+        size_t println(int v);
+};
+
+class HardwareSerial : public Print {
+    public:
+        void begin(unsigned long baud) {}
+        int  available() { return 0; }
+        int  read() { return -1; }
+        int  availableForWrite() { return 128; }
+        void flush() {}
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+    public:
+        uint32_t getCycleCount();
+        uint32_t getCpuFreqMHz() { return 240; }
+        uint32_t getFreeHeap() { return 200000; }
+        void     restart() { exit(0); }
+};
+extern EspClass ESP;
+
+#endif
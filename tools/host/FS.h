@@ -0,0 +1,10 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host build of the firmware (tools/replay.cpp, tools/bench.cpp): See SD.h
+ * -------------------------------------------------------------------
+ */
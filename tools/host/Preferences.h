@@ -0,0 +1,28 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host build of the firmware (tools/replay.cpp, tools/bench.cpp):
+ * NVS is empty and read-only, so nothing persists between runs.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _HOST_PREFERENCES_H
+#define _HOST_PREFERENCES_H
+
+#include <Arduino.h>
+
+class Preferences {
+    public:
+        bool   begin(const char *name, bool readOnly = false) { return false; }
+        void   end() {}
+        size_t putBytes(const char *key, const void *val, size_t len) { return 0; }
+        size_t getBytes(const char *key, void *buf, size_t len) { return 0; }
+        size_t getBytesLength(const char *key) { return 0; }
+        bool   remove(const char *key) { return false; }
+};
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host build of the firmware (tools/replay.cpp, tools/bench.cpp): No SD card.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _HOST_SD_H
+#define _HOST_SD_H
+
+#include <Arduino.h>
+
+#define FILE_READ     "r"
+#define FILE_WRITE    "w"
+#define CARD_NONE     0
+#define CARD_UNKNOWN  4
+
+class SPIClass;
+
+class File {
+    public:
+        operator bool() const { return false; }
+        size_t read(uint8_t *buf, size_t len) { return 0; }
+        int    read() { return -1; }
+        int    available() { return 0; }
+        int    peek() { return -1; }
+        size_t size() { return 0; }
+        size_t write(const uint8_t *buf, size_t len) { return 0; }
+        void   close() {}
+        String readStringUntil(char term) { return String(); }
+};
+
+class SDFS {
+    public:
+        bool    begin(int cs, SPIClass& spi, uint32_t freq) { return false; }
+        uint8_t cardType() { return CARD_NONE; }
+        bool    exists(const char *path) { return false; }
+        File    open(const char *path, const char *mode = FILE_READ) { return File(); }
+        bool    remove(const char *path) { return false; }
+        bool    rename(const char *from, const char *to) { return false; }
+        void    end() {}
+};
+
+extern SDFS SD;
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host build of the firmware (tools/replay.cpp, tools/bench.cpp):
+ * I2C controller. The devices on the bus are emulated in
+ * tools/host/host.cpp.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _HOST_WIRE_H
+#define _HOST_WIRE_H
+
+#include <Arduino.h>
+
+#define HOST_I2C_BUF 128
+
+class TwoWire {
+    public:
+        TwoWire(uint8_t num) : _num(num) {}
+        bool    begin(int sda = -1, int scl = -1, uint32_t freq = 0);
+        size_t  setBufferSize(size_t size) { return size; }
+        bool    setClock(uint32_t freq) { _clock = freq; return true; }
+        uint32_t getClock() { return _clock; }
+
+        void    beginTransmission(uint8_t address);
+        size_t  write(uint8_t val);
+        size_t  write(const uint8_t *buf, size_t len);
+        uint8_t endTransmission(bool stop = true);
+
+        uint8_t requestFrom(uint8_t address, uint8_t len);
+        int     available() { return _rxLen - _rxPos; }
+        int     read() { return (_rxPos < _rxLen) ? _rxBuf[_rxPos++] : -1; }
+
+    private:
+        uint8_t  _num;
+        uint32_t _clock = 100000;
+        uint8_t  _txAddr = 0;
+        uint8_t  _txBuf[HOST_I2C_BUF];
+        int      _txLen = 0;
+        uint8_t  _rxBuf[HOST_I2C_BUF];
+        int      _rxLen = 0;
+        int      _rxPos = 0;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
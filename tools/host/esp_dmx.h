@@ -0,0 +1,98 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host build of the firmware (tools/replay.cpp, tools/bench.cpp):
+ * esp_dmx driver API, as far as the firmware uses it. Packets come
+ * from the host tool's main program (see host.h); RDM is not
+ * emulated.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _HOST_ESP_DMX_H
+#define _HOST_ESP_DMX_H
+
+#include <Arduino.h>
+
+typedef int dmx_port_t;
+
+#define DMX_PACKET_SIZE               513
+#define DMX_INTR_FLAGS_DEFAULT        0
+#define DMX_TIMEOUT_TICK              0x7fffffff
+#define RDM_PRODUCT_CATEGORY_FIXTURE  0x0100
+
+typedef enum {
+    DMX_OK = 0,
+    DMX_ERR_TIMEOUT,
+    DMX_ERR_UART_OVERFLOW,
+    DMX_ERR_IMPROPER_SLOT,
+    DMX_ERR_NOT_ENOUGH_SLOTS,
+    DMX_ERR_DATA_COLLISION,
+    DMX_ERR_INVALID_ARG,
+    DMX_ERR_NOT_INSTALLED
+} dmx_err_t;
+
+typedef struct {
+    dmx_err_t err;
+    int       sc;
+    size_t    size;
+    bool      is_rdm;
+} dmx_packet_t;
+
+typedef struct {
+    int         interrupt_flags;
+    int         root_device_parameter_count;
+    int         sub_device_parameter_count;
+    uint16_t    model_id;
+    uint16_t    product_category;
+    uint32_t    software_version_id;
+    const char *software_version_label;
+    int         queue_size_max;
+} dmx_config_t;
+
+typedef struct {
+    uint16_t    footprint;
+    const char *description;
+} dmx_personality_t;
+
+bool     dmx_driver_install(dmx_port_t port, dmx_config_t *config, dmx_personality_t *pers, int count);
+bool     dmx_set_pin(dmx_port_t port, int tx, int rx, int rts);
+size_t   dmx_receive_num(dmx_port_t port, dmx_packet_t *packet, size_t num, TickType_t wait);
+size_t   dmx_receive(dmx_port_t port, dmx_packet_t *packet, TickType_t wait);
+size_t   dmx_read(dmx_port_t port, void *dst, size_t size);
+size_t   dmx_read_offset(dmx_port_t port, size_t offset, void *dst, size_t size);
+int      dmx_read_slot(dmx_port_t port, size_t slot);
+uint8_t  dmx_get_current_personality(dmx_port_t port);
+uint16_t dmx_get_start_address(dmx_port_t port);
+
+typedef uint16_t rdm_pid_t;
+typedef struct rdm_header_t rdm_header_t;
+
+typedef struct {
+    rdm_pid_t pid;
+    uint8_t   pdl_size;
+    uint8_t   data_type;
+    uint8_t   cc;
+    uint8_t   unit;
+    uint8_t   prefix;
+    uint32_t  min_value;
+    uint32_t  max_value;
+    uint32_t  default_value;
+    char      description[33];
+} rdm_pid_description_t;
+
+typedef void (*rdm_callback_t)(dmx_port_t port, const rdm_header_t *header, void *context);
+
+#define RDM_DS_NOT_DEFINED     0
+#define RDM_DS_UNSIGNED_DWORD  5
+#define RDM_CC_GET             1
+#define RDM_UNITS_NONE         0
+#define RDM_PREFIX_NONE        0
+
+inline bool rdm_register_manufacturer_specific_simple(dmx_port_t, rdm_pid_description_t, void *,
+                            const char *, rdm_callback_t, void *) { return true; }
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host build of the firmware (tools/replay.cpp, tools/bench.cpp):
+ * Cycle counter, derived from the emulated time (see host.h)
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _HOST_CPU_HAL_H
+#define _HOST_CPU_HAL_H
+
+#include <stdint.h>
+
+uint32_t cpu_hal_get_cycle_count();
+
+#endif
@@ -0,0 +1,496 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host build of the firmware: Emulated time, timers, pins, Serial,
+ * the I2C bus with its devices, and the DMX drivers (esp_dmx, and the
+ * lean receiver with TC_LEAN_RX). See host.h.
+ *
+ * Built with the same options as the firmware (tcd-DMX/tc_global.h,
+ * or -D on the command line), along with a main program; see
+ * tools/replay.cpp and tools/bench.cpp.
+ * -------------------------------------------------------------------
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <SD.h>
+#include <esp_dmx.h>
+#include <hal/cpu_hal.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "tc_global.h"
+#include "tc_dmxrx.h"
+#include "host.h"
+
+// As in tcd-DMX/tc_dmx.cpp
+#define HOST_SPEEDO_ADDR   0x70
+#define HOST_DS3231_ADDR   0x68
+
+/*
+ * Emulated time
+ */
+
+uint64_t hostNow = 0;
+bool     hostCpuTime = false;
+
+struct hw_timer_s {
+    void     (*isr)();
+    uint64_t period;
+    uint64_t next;
+    bool     enabled;
+};
+
+static hw_timer_s hostTimers[4];
+static void     (*sqwISR)() = NULL;
+static int        sqwMode = 0;
+
+// Advance time, running timer and 1Hz interrupts on the way. The
+// 1Hz signal is low in the first half of each second.
+void hostAdvance(uint64_t to)
+{
+    for(;;) {
+        uint64_t next = to;
+        int      which = -1;
+
+        for(int i = 0; i < 4; i++) {
+            if(hostTimers[i].enabled && hostTimers[i].isr && hostTimers[i].next <= next) {
+                next = hostTimers[i].next;
+                which = i;
+            }
+        }
+        if(sqwISR) {
+            uint64_t edge = (hostNow / 500000 + 1) * 500000;
+            if(edge <= next) {
+                next = edge;
+                which = 4;
+            }
+        }
+        if(which < 0)
+            break;
+
+        hostNow = next;
+
+        if(which == 4) {
+            bool falling = !(hostNow % 1000000);
+            if(sqwMode == CHANGE || (sqwMode == FALLING) == falling) sqwISR();
+        } else {
+            hostTimers[which].next += hostTimers[which].period;
+            hostTimers[which].isr();
+        }
+    }
+
+    if(to > hostNow) hostNow = to;
+}
+
+static uint64_t cpuNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// At 240MHz; with hostCpuTime, plus the host's run time since the
+// first such call
+uint32_t cpu_hal_get_cycle_count()
+{
+    static uint64_t cpuStart = 0;
+    uint64_t ns = hostNow * 1000;
+
+    if(hostCpuTime) {
+        if(!cpuStart) cpuStart = cpuNs();
+        ns += cpuNs() - cpuStart;
+    }
+
+    return (uint32_t)(ns * 240 / 1000);
+}
+
+unsigned long millis()            { return hostNow / 1000; }
+unsigned long micros()            { return hostNow; }
+int64_t  esp_timer_get_time()     { return hostNow; }
+uint32_t EspClass::getCycleCount(){ return cpu_hal_get_cycle_count(); }
+void     delay(unsigned long ms)  { hostAdvance(hostNow + ms * 1000); }
+void     delayMicroseconds(unsigned int us) { hostAdvance(hostNow + us); }
+void     vTaskDelay(TickType_t ticks) { delay(ticks); }
+TickType_t xTaskGetTickCount()    { return millis(); }
+
+void vTaskDelayUntil(TickType_t *last, TickType_t ticks)
+{
+    *last += ticks;
+    if(*last > millis()) delay(*last - millis());
+}
+
+hw_timer_t *timerBegin(uint8_t num, uint16_t divider, bool countUp)
+{
+    return &hostTimers[num & 3];
+}
+
+void timerAttachInterrupt(hw_timer_t *timer, void (*isr)(), bool edge)
+{
+    timer->isr = isr;
+}
+
+void timerAlarmWrite(hw_timer_t *timer, uint64_t alarm, bool autoReload)
+{
+    timer->period = alarm ? alarm : 1;     // Timers count microseconds
+}
+
+void timerAlarmEnable(hw_timer_t *timer)
+{
+    timer->next = hostNow + timer->period;
+    timer->enabled = true;
+}
+
+void timerAlarmDisable(hw_timer_t *timer)
+{
+    timer->enabled = false;
+}
+
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+int  digitalPinToInterrupt(int pin) { return pin; }
+
+int digitalRead(int pin)
+{
+    if(pin == SECONDS_IN_PIN) {
+        return (hostNow % 1000000 >= 500000) ? HIGH : LOW;
+    }
+    return LOW;
+}
+
+void attachInterrupt(int irq, void (*isr)(), int mode)
+{
+    if(irq == SECONDS_IN_PIN) {
+        sqwISR = isr;
+        sqwMode = mode;
+    }
+}
+
+uint32_t esp_random()
+{
+    static uint32_t seed = 1;
+    seed = seed * 1103515245 + 12345;
+    return seed;
+}
+
+esp_reset_reason_t esp_reset_reason()
+{
+    return ESP_RST_POWERON;
+}
+
+/*
+ * Serial
+ */
+
+FILE *hostSerial = NULL;
+
+HardwareSerial Serial;
+EspClass       ESP;
+SDFS           SD;
+
+size_t Print::write(uint8_t c)                      { if(hostSerial) fputc(c, hostSerial); return 1; }
+size_t Print::write(const uint8_t *buf, size_t len) { if(hostSerial) fwrite(buf, 1, len, hostSerial); return len; }
+size_t Print::print(const char *s)                  { if(hostSerial) fputs(s, hostSerial); return strlen(s); }
+size_t Print::print(int v)                          { if(hostSerial) fprintf(hostSerial, "%d", v); return 1; }
+size_t Print::println(const char *s)                { if(hostSerial) fprintf(hostSerial, "%s\n", s); return strlen(s) + 1; }
+size_t Print::println(int v)                        { if(hostSerial) fprintf(hostSerial, "%d\n", v); return 1; }
+
+int Print::printf(const char *fmt, ...)
+{
+    va_list ap;
+    int     ret;
+
+    va_start(ap, fmt);
+    ret = hostSerial ? vfprintf(hostSerial, fmt, ap) : 0;
+    va_end(ap);
+
+    return ret;
+}
+
+/*
+ * I2C bus and devices
+ */
+
+std::vector<hostHT16K33> hostDisplays;
+static uint8_t  muxSel[2] = { 0, 0 };
+uint32_t hostBusBytes = 0, hostBusTrans = 0;
+
+// DS3231: Registers; the time registers follow the emulated time
+static uint8_t  rtcRegs[0x13];
+static uint8_t  rtcPtr = 0;
+static time_t   rtcBase;            // Time set ...
+static uint64_t rtcBaseAt;          // ... at this emulated time
+
+TwoWire Wire(0);
+TwoWire Wire1(1);
+
+static uint8_t bin2bcd(int v) { return ((v / 10) << 4) | (v % 10); }
+static int     bcd2bin(uint8_t v) { return (v >> 4) * 10 + (v & 0x0f); }
+
+void hostRtcSetup()
+{
+    struct tm t;
+
+    memset(rtcRegs, 0, sizeof(rtcRegs));
+    rtcRegs[0x0e] = 0x1c;           // Control: INTCN
+    rtcRegs[0x11] = 25;             // 25 deg C
+
+    memset(&t, 0, sizeof(t));
+    t.tm_year = 2024 - 1900;
+    t.tm_mday = 1;
+    rtcBase = timegm(&t);
+    rtcBaseAt = 0;
+}
+
+static void rtcGetTime()
+{
+    time_t now = rtcBase + (time_t)((hostNow - rtcBaseAt) / 1000000);
+    struct tm t;
+
+    gmtime_r(&now, &t);
+    rtcRegs[0] = bin2bcd(t.tm_sec);
+    rtcRegs[1] = bin2bcd(t.tm_min);
+    rtcRegs[2] = bin2bcd(t.tm_hour);
+    rtcRegs[3] = t.tm_wday + 1;
+    rtcRegs[4] = bin2bcd(t.tm_mday);
+    rtcRegs[5] = bin2bcd(t.tm_mon + 1);
+    rtcRegs[6] = bin2bcd(t.tm_year % 100);
+}
+
+static void rtcSetTime()
+{
+    struct tm t;
+
+    memset(&t, 0, sizeof(t));
+    t.tm_sec = bcd2bin(rtcRegs[0] & 0x7f);
+    t.tm_min = bcd2bin(rtcRegs[1]);
+    t.tm_hour = bcd2bin(rtcRegs[2] & 0x3f);
+    t.tm_mday = bcd2bin(rtcRegs[4]);
+    t.tm_mon = bcd2bin(rtcRegs[5] & 0x1f) - 1;
+    t.tm_year = bcd2bin(rtcRegs[6]) + 100;
+    rtcBase = timegm(&t);
+    rtcBaseAt = hostNow;
+}
+
+static bool isDisplayAddr(uint8_t addr)
+{
+    return addr >= 0x70 && addr <= 0x77 && addr != TC_MUX_ADDR;
+}
+
+// Find (or, on its first access, install) the HT16K33 at addr
+// on the bus' selected multiplexer channel
+static hostHT16K33 *findDisplay(int bus, uint8_t addr)
+{
+    uint8_t chan = HOST_NO_MUX;
+
+    if(TC_NUM_PANELS > 1 && addr != HOST_SPEEDO_ADDR) {
+        // Exactly one channel must be selected
+        if(!muxSel[bus] || (muxSel[bus] & (muxSel[bus] - 1)))
+            return NULL;
+        chan = __builtin_ctz(muxSel[bus]);
+    }
+
+    for(hostHT16K33& d : hostDisplays) {
+        if(d.bus == bus && d.chan == chan && d.addr == addr)
+            return &d;
+    }
+
+    hostHT16K33 d;
+    memset(&d, 0, sizeof(d));
+    d.bus = bus;
+    d.chan = chan;
+    d.addr = addr;
+    hostDisplays.push_back(d);
+
+    return &hostDisplays.back();
+}
+
+// Bus time of a transaction with len bytes after the address
+static void busTime(TwoWire *w, int len)
+{
+    hostAdvance(hostNow + ((1 + 9 * (1 + len) + 1) * 1000000ULL + w->getClock() - 1) / w->getClock());
+    hostBusBytes += 1 + len;
+    hostBusTrans++;
+}
+
+bool TwoWire::begin(int sda, int scl, uint32_t freq)
+{
+    if(freq) _clock = freq;
+    return true;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+    _txAddr = address;
+    _txLen = 0;
+}
+
+size_t TwoWire::write(uint8_t val)
+{
+    if(_txLen >= HOST_I2C_BUF)
+        return 0;
+    _txBuf[_txLen++] = val;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buf, size_t len)
+{
+    size_t n = 0;
+
+    while(n < len && write(buf[n])) n++;
+
+    return n;
+}
+
+// Returns 0 if acknowledged, 2 (NACK on address) if there is no device
+uint8_t TwoWire::endTransmission(bool stop)
+{
+    hostHT16K33 *d;
+
+    busTime(this, _txLen);
+
+    if(_txAddr == TC_MUX_ADDR && TC_NUM_PANELS > 1) {
+        if(_txLen) muxSel[_num] = _txBuf[_txLen - 1];
+        return 0;
+    }
+
+    if(_txAddr == HOST_DS3231_ADDR && !_num) {
+        if(_txLen) {
+            rtcPtr = _txBuf[0];
+            for(int i = 1; i < _txLen; i++) {
+                if(rtcPtr < sizeof(rtcRegs)) rtcRegs[rtcPtr] = _txBuf[i];
+                if(rtcPtr++ == 6) rtcSetTime();
+            }
+        }
+        return 0;
+    }
+
+    if(isDisplayAddr(_txAddr) && (d = findDisplay(_num, _txAddr))) {
+        if(_txLen) {
+            uint8_t cmd = _txBuf[0];
+            if(cmd < 0x10) {
+                // Display RAM, auto increment
+                for(int i = 1; i < _txLen; i++) {
+                    d->ram[(cmd + i - 1) & 0x0f] = _txBuf[i];
+                }
+            } else if((cmd & 0xf0) == 0x80) {
+                d->setup = cmd & 0x07;
+            } else if((cmd & 0xf0) == 0xe0) {
+                d->dim = cmd & 0x0f;
+            }
+        }
+        return 0;
+    }
+
+    return 2;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t len)
+{
+    _rxLen = _rxPos = 0;
+
+    busTime(this, len);
+
+    if(address != HOST_DS3231_ADDR || _num)
+        return 0;
+
+    rtcGetTime();
+    while(_rxLen < len && _rxLen < HOST_I2C_BUF) {
+        _rxBuf[_rxLen++] = (rtcPtr < sizeof(rtcRegs)) ? rtcRegs[rtcPtr] : 0;
+        rtcPtr++;
+    }
+
+    return _rxLen;
+}
+
+/*
+ * DMX
+ */
+
+bool    (*hostDmxReceive)(TickType_t wait) = NULL;
+uint8_t hostDmxData[DMX_PACKET_SIZE];
+int     hostDmxSize = 0;
+int64_t hostDmxBreak = 0;
+int     hostDmxPers = 1;
+
+static bool hostReceive(TickType_t wait)
+{
+    if(hostDmxReceive)
+        return hostDmxReceive(wait);
+
+    hostAdvance(hostNow + (wait ? (uint64_t)wait * 1000 : HOST_POLL_US));
+    return false;
+}
+
+bool dmx_driver_install(dmx_port_t port, dmx_config_t *config, dmx_personality_t *pers, int count)
+{
+    if(hostDmxPers > count) hostDmxPers = 1;
+    return true;
+}
+
+bool dmx_set_pin(dmx_port_t port, int tx, int rx, int rts) { return true; }
+
+size_t dmx_receive_num(dmx_port_t port, dmx_packet_t *packet, size_t num, TickType_t wait)
+{
+    if(!hostReceive(wait))
+        return 0;
+
+    packet->err = (hostDmxSize > 0) ? DMX_OK : DMX_ERR_NOT_ENOUGH_SLOTS;
+    packet->sc = hostDmxData[0];
+    packet->size = hostDmxSize;
+    packet->is_rdm = false;
+
+    return hostDmxSize;
+}
+
+size_t dmx_receive(dmx_port_t port, dmx_packet_t *packet, TickType_t wait)
+{
+    return dmx_receive_num(port, packet, DMX_PACKET_SIZE, wait);
+}
+
+size_t dmx_read_offset(dmx_port_t port, size_t offset, void *dst, size_t size)
+{
+    if(offset >= DMX_PACKET_SIZE)
+        return 0;
+    size = min(size, DMX_PACKET_SIZE - offset);
+    memcpy(dst, hostDmxData + offset, size);
+    return size;
+}
+
+size_t   dmx_read(dmx_port_t port, void *dst, size_t size) { return dmx_read_offset(port, 0, dst, size); }
+int      dmx_read_slot(dmx_port_t port, size_t slot) { return (slot < DMX_PACKET_SIZE) ? hostDmxData[slot] : -1; }
+uint8_t  dmx_get_current_personality(dmx_port_t port) { return hostDmxPers; }
+uint16_t dmx_get_start_address(dmx_port_t port) { return 1; }
+
+#ifdef TC_LEAN_RX
+static int      rxAlign = 0;
+static uint32_t rxBuf[(3 + DMXRX_PACKET_SIZE + 3) / 4];
+
+void dmxrx_setup(int rxPin, int slots, int align)
+{
+    rxAlign = align & 3;
+}
+
+int dmxrx_receive(uint8_t **data, int *err, int64_t *breakTime, TickType_t wait)
+{
+    if(!hostReceive(wait))
+        return 0;
+
+    memcpy((uint8_t *)rxBuf + rxAlign, hostDmxData, DMXRX_PACKET_SIZE);
+    *data = (uint8_t *)rxBuf + rxAlign;
+    *err = DMX_OK;
+    *breakTime = hostDmxBreak;
+
+    return hostDmxSize;
+}
+
+void dmxrx_isr_stats(uint32_t *cyclesMax, uint32_t *cycles)
+{
+    *cyclesMax = *cycles = 0;
+}
+#endif
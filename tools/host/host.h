@@ -0,0 +1,73 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host build of the firmware: The emulation in tools/host/host.cpp,
+ * as seen by the host tools' main programs (tools/replay.cpp,
+ * tools/bench.cpp).
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _HOST_HOST_H
+#define _HOST_HOST_H
+
+#include <Arduino.h>
+#include <esp_dmx.h>
+#include <vector>
+
+#define HOST_POLL_US     1000       // Time per loop pass without a packet (polling)
+#define HOST_NO_MUX      0xff
+
+/*
+ * Time: Emulated, in us. It advances with bus transactions (at the
+ * bus clock, no gaps) and with waits. Timers and the RTC's 1Hz signal
+ * run on this time.
+ *
+ * The cycle counter follows the emulated time at 240MHz. With
+ * hostCpuTime set, the host's own run time (CLOCK_MONOTONIC) since
+ * then is added, so code that does not touch the bus is timed too.
+ */
+extern uint64_t hostNow;
+extern bool     hostCpuTime;
+
+void hostAdvance(uint64_t to);
+
+// Firmware's Serial output (NULL = discarded)
+extern FILE *hostSerial;
+
+/*
+ * I2C devices: HT16K33 displays (installed on their first access),
+ * a TCA9548A multiplexer and a DS3231 RTC
+ */
+struct hostHT16K33 {
+    int     bus;
+    uint8_t chan;                   // Multiplexer channel; HOST_NO_MUX = main bus
+    uint8_t addr;
+    uint8_t ram[16];
+    uint8_t setup;                  // Display setup: on, blink
+    uint8_t dim;                    // Brightness
+};
+
+extern std::vector<hostHT16K33> hostDisplays;
+extern uint32_t hostBusBytes, hostBusTrans;    // Since reset by the caller
+
+// RTC set to 2024-01-01 00:00:00 at emulated time 0
+void hostRtcSetup();
+
+/*
+ * DMX: Packets come from hostDmxReceive (if set), which returns true
+ * with a packet in hostDmxData/hostDmxSize/hostDmxBreak, or waits up
+ * to wait ticks (0 = one poll) and returns false. Without it, no
+ * packet is ever received. hostDmxPers is the personality as selected
+ * through RDM.
+ */
+extern bool    (*hostDmxReceive)(TickType_t wait);
+extern uint8_t hostDmxData[DMX_PACKET_SIZE];
+extern int     hostDmxSize;
+extern int64_t hostDmxBreak;
+extern int     hostDmxPers;
+
+#endif
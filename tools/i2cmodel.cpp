@@ -0,0 +1,209 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * I2C bus timing model
+ *
+ * Takes the I2C transactions of a trace dump (see tcd-DMX/tc_trace.cpp)
+ * captured from Serial during a show, and computes for each frame
+ * (from one packet's receive to the next) the bus time at 100kHz,
+ * 400kHz and 1MHz, an estimate of the latency from receive to the
+ * end of the display update, and the maximum refresh rate the
+ * firmware could sustain.
+ *
+ * A transaction takes a start condition, 9 clocks (8 bits and ACK)
+ * per byte including the address byte, and a stop condition; a
+ * register read is a write of the register address followed by a
+ * read. Each transaction is followed by a gap (driver overhead,
+ * independent of the clock), which is derived from the measured
+ * transaction times at the capture's clock unless given.
+ * Frame latency is the measured frame time with the measured bus
+ * time replaced by the modelled one. With TC_I2C_SPLIT, both buses
+ * are assumed to run concurrently.
+ *
+ * Build and run on the host (from the repository's top directory):
+ *
+ * g++ -std=c++11 -o i2cmodel tools/i2cmodel.cpp
+ * ./i2cmodel [capture clock (Hz) [gap (us)]] < serial.log
+ *
+ * The capture clock defaults to 100000, the firmware's setting.
+ * -------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#define NUM_CLOCKS  3
+#define NUM_BUSES   2
+#define DMX_FRAME_US 22700
+
+static const double clocks[NUM_CLOCKS] = { 100000, 400000, 1000000 };
+static const char  *clockNames[NUM_CLOCKS] = { "100kHz", "400kHz", "1MHz" };
+
+struct txn {
+    int    bus;
+    int    len;
+    bool   rd;
+    double measured;            // us
+};
+
+struct frame {
+    double start, end;          // us
+    std::vector<txn> txns;
+};
+
+// Bus clocks of a transaction, without gaps
+static int txnClocks(const txn& t)
+{
+    if(t.rd) {
+        return (1 + 9 * 2 + 1) + (1 + 9 * (1 + t.len) + 1);
+    }
+    return 1 + 9 * (1 + t.len) + 1;
+}
+
+static int txnCount(const txn& t)
+{
+    return t.rd ? 2 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    char     line[256], name[32], phase;
+    unsigned long mhz = 240, cycles, num;
+    unsigned int arg;
+    int      core;
+    uint32_t last[2] = { 0, 0 };
+    uint64_t wraps[2] = { 0, 0 };
+    double   i2cStart[2] = { -1, -1 };
+    double   capClock = 100000, gap = -1;
+    std::vector<frame> frames;
+
+    if(argc > 1) capClock = atof(argv[1]);
+    if(argc > 2) gap = atof(argv[2]);
+    if(argc > 3 || capClock <= 0) {
+        fprintf(stderr, "Usage: %s [capture clock (Hz) [gap (us)]] < serial.log\n", argv[0]);
+        return 1;
+    }
+
+    while(fgets(line, sizeof(line), stdin)) {
+        double ts;
+
+        if(sscanf(line, "trace,begin,%lu,%lu", &mhz, &num) == 2) {
+            if(!mhz) mhz = 240;
+            continue;
+        }
+        if(sscanf(line, "trace,%lu,%d,%31[^,],%c,%u", &cycles, &core, name, &phase, &arg) != 5)
+            continue;
+
+        core &= 1;
+        if((uint32_t)cycles < last[core]) wraps[core] += 1ULL << 32;
+        last[core] = (uint32_t)cycles;
+        ts = (double)(wraps[core] + cycles) / mhz;
+
+        if(!strcmp(name, "Receive") && phase == 'B') {
+            frame f;
+            f.start = f.end = ts;
+            frames.push_back(f);
+        } else if(frames.empty()) {
+            continue;
+        } else if(!strcmp(name, "I2C")) {
+            if(phase == 'B') {
+                i2cStart[core] = ts;
+            } else if(i2cStart[core] >= 0) {
+                txn t;
+                t.bus = (arg >> 7) & 1;
+                t.len = (arg >> 8) & 0x7f;
+                t.rd = (arg >> 15) & 1;
+                t.measured = ts - i2cStart[core];
+                frames.back().txns.push_back(t);
+                i2cStart[core] = -1;
+            }
+        }
+
+        if(!frames.empty() && ts > frames.back().end) {
+            frames.back().end = ts;
+        }
+    }
+
+    // The last frame is incomplete
+    if(!frames.empty()) frames.pop_back();
+
+    if(frames.empty()) {
+        fprintf(stderr, "No complete frames in input\n");
+        return 1;
+    }
+
+    // Gap per transaction: Measured time beyond the modelled one
+    if(gap < 0) {
+        double over = 0;
+        int    cnt = 0;
+        for(const frame& f : frames) {
+            for(const txn& t : f.txns) {
+                over += t.measured - txnClocks(t) * 1e6 / capClock;
+                cnt += txnCount(t);
+            }
+        }
+        gap = (cnt && over > 0) ? over / cnt : 0;
+    }
+
+    double bytesSum = 0, bytesMax = 0, txnsSum = 0, txnsMax = 0;
+    double busSum[NUM_CLOCKS] = { 0 }, busMax[NUM_CLOCKS] = { 0 };
+    double latSum[NUM_CLOCKS] = { 0 }, latMax[NUM_CLOCKS] = { 0 };
+    int    overruns[NUM_CLOCKS] = { 0 };
+
+    for(const frame& f : frames) {
+        double measured[NUM_BUSES] = { 0 };
+        double modelled[NUM_CLOCKS][NUM_BUSES] = { { 0 } };
+        int    bytes = 0, cnt = 0;
+
+        for(const txn& t : f.txns) {
+            measured[t.bus] += t.measured;
+            for(int c = 0; c < NUM_CLOCKS; c++) {
+                modelled[c][t.bus] += txnClocks(t) * 1e6 / clocks[c] + txnCount(t) * gap;
+            }
+            bytes += (t.rd ? 3 : 1) + t.len;
+            cnt += txnCount(t);
+        }
+
+        double cpu = (f.end - f.start) - ((measured[0] > measured[1]) ? measured[0] : measured[1]);
+        if(cpu < 0) cpu = 0;
+
+        bytesSum += bytes;
+        txnsSum += cnt;
+        if(bytes > bytesMax) bytesMax = bytes;
+        if(cnt > txnsMax) txnsMax = cnt;
+
+        for(int c = 0; c < NUM_CLOCKS; c++) {
+            double bus = (modelled[c][0] > modelled[c][1]) ? modelled[c][0] : modelled[c][1];
+            double lat = cpu + bus;
+            busSum[c] += bus;
+            latSum[c] += lat;
+            if(bus > busMax[c]) busMax[c] = bus;
+            if(lat > latMax[c]) latMax[c] = lat;
+            if(lat > DMX_FRAME_US) overruns[c]++;
+        }
+    }
+
+    int n = frames.size();
+
+    printf("Frames: %d\n", n);
+    printf("Bytes per frame: %.1f avg, %.0f max\n", bytesSum / n, bytesMax);
+    printf("Transactions per frame: %.1f avg, %.0f max\n", txnsSum / n, txnsMax);
+    printf("Gap per transaction: %.1f us\n\n", gap);
+
+    printf("Clock     Bus time (us)      Latency (us)       Max refresh  Frames over\n");
+    printf("          avg      max       avg      max       (Hz)         %d us\n", DMX_FRAME_US);
+    for(int c = 0; c < NUM_CLOCKS; c++) {
+        printf("%-8s  %7.0f  %7.0f   %7.0f  %7.0f   %7.1f      %d\n",
+               clockNames[c], busSum[c] / n, busMax[c], latSum[c] / n, latMax[c],
+               latMax[c] > 0 ? 1e6 / latMax[c] : 0.0, overruns[c]);
+    }
+
+    return 0;
+}
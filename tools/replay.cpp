@@ -0,0 +1,364 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * DMX replay and golden image test
+ *
+ * Runs the firmware's DMX loop (tcd-DMX/tc_dmx.cpp and the display
+ * drivers, unmodified) on the host, fed with a capture of DMX packets,
+ * against an emulated I2C bus with HT16K33 displays, a TCA9548A
+ * multiplexer and a DS3231 RTC. The host headers in tools/host stand
+ * in for the Arduino core, esp_dmx, NVS and SD; tools/host/host.cpp
+ * emulates the hardware.
+ *
+ * For each packet ("frame": from its receipt to the next packet's),
+ * the contents of all displays' RAM (plus display on/blink and
+ * brightness) are recorded as golden images, or compared with
+ * previously recorded ones; and the bytes (including address bytes)
+ * and transactions put on the bus are counted. A frame whose bus
+ * traffic exceeds the budget fails the run, as does any difference
+ * from the golden images. So changes to the decoder or the display
+ * drivers can be checked for both their output and their bus traffic.
+ *
+ * Time is emulated: It advances with bus transactions (at the bus
+ * clock, no gaps), with the loop's waits for packets, and with the
+ * capture's timestamps. Timers and the RTC's 1Hz signal run on this
+ * time, so a replay is deterministic.
+ *
+ * Capture format (text, one packet per line; '#' starts a comment):
+ *
+ * <time (ms)> <slots (hex, start code first)>
+ *
+ * The time is when the packet was complete. Slots are given as hex
+ * bytes, separated by blanks or not ("00 ff 10" or "00ff10").
+ *
+ * Build and run on the host (from the repository's top directory),
+ * with the same build options as the firmware (tcd-DMX/tc_global.h,
+ * or -D on the command line):
+ *
+ * g++ -std=gnu++11 -Itools/host -Itcd-DMX -o replay tools/replay.cpp \
+ *     tools/host/host.cpp tcd-DMX/tc_dmx.cpp tcd-DMX/clockdisplay.cpp tcd-DMX/speeddisplay.cpp \
+ *     tcd-DMX/rtc.cpp tcd-DMX/tc_log.cpp tcd-DMX/tc_userpers.cpp \
+ *     tcd-DMX/tc_cues.cpp tcd-DMX/tc_scenes.cpp tcd-DMX/tc_trace.cpp
+ *
+ * ./replay [-p personality] [-b budget] [-v] [-t trace] [-r golden | -c golden] < capture
+ *
+ * -p  DMX personality as selected through RDM (1-3; default 1)
+ * -b  Bus bytes per frame that fail the run (default: the firmware's
+ *     per loop pass budget, I2C_BUDGET_PASS in tc_stats.h; 0 = no check)
+ * -v  Print the firmware's Serial output on stderr
+ * -t  Write the firmware's trace (build with TC_TRACE) into the given
+ *     file, dumped after each frame; the I2C transactions are those on
+ *     the emulated bus, at emulated time. The file can be fed to
+ *     tools/trace2json.cpp and tools/i2cmodel.cpp.
+ * -r  Record golden images into the given file
+ * -c  Compare with the golden images in the given file
+ *
+ * The second I2C bus (TC_I2C_SPLIT) is not supported, as the bus 1
+ * task is not run.
+ * -------------------------------------------------------------------
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+
+#include "tc_global.h"
+#include "tc_dmx.h"
+#include "tc_trace.h"
+#include "tc_stats.h"
+#include "host.h"
+
+#ifdef TC_I2C_SPLIT
+#error "TC_I2C_SPLIT is not supported by the replay"
+#endif
+
+#define RP_TAIL_US      22700       // Length of the last frame
+#define RP_BREAK_US       120       // Break and MAB before a packet's slots
+#define RP_SLOT_US         44
+
+/*
+ * DMX: Packets from the capture
+ */
+
+struct rpFrame {
+    uint64_t time;                  // us, emulated
+    std::vector<uint8_t> slots;
+};
+
+static std::vector<rpFrame> frames;
+static size_t   rpNext = 0;         // Next frame to deliver
+
+static void frameEnd(int f);
+
+// Deliver the next packet if due; otherwise wait for up to
+// wait ticks (polling: one pass' time)
+static bool rpReceive(TickType_t wait)
+{
+    uint64_t until;
+
+    for(int tries = 0; tries < 2; tries++) {
+        if(rpNext < frames.size() && hostNow >= frames[rpNext].time) {
+            if(rpNext) frameEnd(rpNext - 1);
+            hostDmxSize = min((int)frames[rpNext].slots.size(), DMX_PACKET_SIZE);
+            memset(hostDmxData, 0, sizeof(hostDmxData));
+            memcpy(hostDmxData, frames[rpNext].slots.data(), hostDmxSize);
+            hostDmxBreak = frames[rpNext].time - hostDmxSize * RP_SLOT_US - RP_BREAK_US;
+            rpNext++;
+            return true;
+        }
+        if(tries)
+            break;
+
+        until = hostNow + (wait ? (uint64_t)wait * 1000 : HOST_POLL_US);
+        if(rpNext < frames.size() && frames[rpNext].time < until) {
+            until = frames[rpNext].time;
+        }
+        hostAdvance(until);
+    }
+
+    return false;
+}
+
+/*
+ * Golden images
+ */
+
+static FILE    *golden = NULL;
+static FILE    *traceOut = NULL;
+static bool     record = false;
+static uint32_t budget = I2C_BUDGET_PASS;
+static int      numMismatch = 0, numOver = 0, numFrames = 0;
+static uint64_t sumBytes = 0, sumTrans = 0, goldBytes = 0;
+static uint32_t maxBytes = 0, maxTrans = 0;
+
+static std::string devName(const hostHT16K33& d)
+{
+    char buf[16];
+
+    if(d.chan == HOST_NO_MUX) snprintf(buf, sizeof(buf), "%d/-/%02x", d.bus, d.addr);
+    else                    snprintf(buf, sizeof(buf), "%d/%d/%02x", d.bus, d.chan, d.addr);
+
+    return buf;
+}
+
+// Image: RAM (hex), display setup, brightness
+static std::string devImage(const hostHT16K33& d)
+{
+    char buf[40];
+    int  n = 0;
+
+    for(int i = 0; i < 16; i++) {
+        n += snprintf(buf + n, sizeof(buf) - n, "%02x", d.ram[i]);
+    }
+    snprintf(buf + n, sizeof(buf) - n, "/%x/%x", d.setup, d.dim);
+
+    return buf;
+}
+
+static std::string devList()
+{
+    std::string s = "# devices";
+
+    for(const hostHT16K33& d : hostDisplays) {
+        s += " " + devName(d);
+    }
+
+    return s;
+}
+
+static void frameEnd(int f)
+{
+    char line[2048];
+
+    numFrames++;
+    sumBytes += hostBusBytes;
+    sumTrans += hostBusTrans;
+    if(hostBusBytes > maxBytes) maxBytes = hostBusBytes;
+    if(hostBusTrans > maxTrans) maxTrans = hostBusTrans;
+
+    if(budget && hostBusBytes > budget) {
+        printf("Frame %d: %lu bus bytes, over budget (%lu)\n", f,
+               (unsigned long)hostBusBytes, (unsigned long)budget);
+        numOver++;
+    }
+
+    if(golden && record) {
+        fprintf(golden, "%d %lu %lu", f, (unsigned long)hostBusBytes, (unsigned long)hostBusTrans);
+        for(const hostHT16K33& d : hostDisplays) {
+            fprintf(golden, " %s", devImage(d).c_str());
+        }
+        fprintf(golden, "\n");
+    } else if(golden) {
+        unsigned long gb, gt;
+        int  gf, pos, n;
+        char img[40];
+
+        if(!fgets(line, sizeof(line), golden) ||
+           sscanf(line, "%d %lu %lu%n", &gf, &gb, &gt, &pos) != 3 || gf != f) {
+            printf("Frame %d: not in golden images\n", f);
+            numMismatch++;
+        } else {
+            goldBytes += gb;
+            for(const hostHT16K33& d : hostDisplays) {
+                if(sscanf(line + pos, "%39s%n", img, &n) != 1) img[0] = 0;
+                pos += n;
+                if(devImage(d) != img) {
+                    printf("Frame %d: display %s is %s, should be %s\n", f,
+                           devName(d).c_str(), devImage(d).c_str(), img);
+                    numMismatch++;
+                }
+            }
+        }
+    }
+
+    hostBusBytes = hostBusTrans = 0;
+
+    #ifdef TC_TRACE
+    // Trace of this frame, as dumped on Serial by the firmware
+    if(traceOut) {
+        FILE *out = hostSerial;
+        hostSerial = traceOut;
+        trace_dump();
+        hostSerial = out;
+    }
+    #endif
+}
+
+static bool readCapture()
+{
+    char     line[2048];
+    uint64_t first = 0;
+
+    while(fgets(line, sizeof(line), stdin)) {
+        char   *p = strchr(line, '#'), *tok;
+        double  ms;
+        rpFrame fr;
+
+        if(p) *p = 0;
+        if(!(tok = strtok(line, " \t\r\n")))
+            continue;
+
+        ms = atof(tok);
+        fr.time = (uint64_t)(ms * 1000.0);
+        if(frames.empty()) first = fr.time;
+        if(fr.time < first || (!frames.empty() && fr.time < frames.back().time)) {
+            fprintf(stderr, "Capture: time goes backwards at packet %d\n", (int)frames.size());
+            return false;
+        }
+        fr.time -= first;
+
+        while((tok = strtok(NULL, " \t\r\n"))) {
+            for(int i = 0; tok[i] && tok[i + 1]; i += 2) {
+                char hex[3] = { tok[i], tok[i + 1], 0 };
+                fr.slots.push_back((uint8_t)strtoul(hex, NULL, 16));
+            }
+        }
+        if(fr.slots.empty()) {
+            fprintf(stderr, "Capture: no slots in packet %d\n", (int)frames.size());
+            return false;
+        }
+
+        frames.push_back(fr);
+    }
+
+    return !frames.empty();
+}
+
+int main(int argc, char *argv[])
+{
+    const char *gname = NULL, *tname = NULL;
+    char        line[2048];
+    uint64_t    start, end;
+    int         opt;
+
+    while((opt = getopt(argc, argv, "p:b:vr:c:t:")) != -1) {
+        switch(opt) {
+        case 'p': hostDmxPers = atoi(optarg); break;
+        case 'b': budget = strtoul(optarg, NULL, 0); break;
+        case 'v': hostSerial = stderr; break;
+        case 't': tname = optarg; break;
+        case 'r': gname = optarg; record = true; break;
+        case 'c': gname = optarg; record = false; break;
+        default:
+            fprintf(stderr, "Usage: %s [-p personality] [-b budget] [-v] [-t trace] [-r golden | -c golden] < capture\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if(!readCapture()) {
+        fprintf(stderr, "No packets in capture\n");
+        return 1;
+    }
+
+    if(gname && !(golden = fopen(gname, record ? "w" : "r"))) {
+        perror(gname);
+        return 1;
+    }
+
+    if(tname) {
+        #ifdef TC_TRACE
+        if(!(traceOut = fopen(tname, "w"))) {
+            perror(tname);
+            return 1;
+        }
+        #else
+        fprintf(stderr, "Trace needs a build with TC_TRACE\n");
+        return 1;
+        #endif
+    }
+
+    srand(1);
+    hostDmxReceive = rpReceive;
+    hostRtcSetup();
+    Wire.begin(-1, -1, TC_I2C_CLOCK);
+
+    dmx_boot();
+    dmx_setup();
+
+    // Boot traffic is not part of the first frame
+    hostBusBytes = hostBusTrans = 0;
+
+    if(golden && record) {
+        fprintf(golden, "%s\n", devList().c_str());
+    } else if(golden) {
+        if(!fgets(line, sizeof(line), golden) || devList() != strtok(line, "\r\n")) {
+            fprintf(stderr, "Golden images are for other displays (%s)\n", devList().c_str());
+            return 1;
+        }
+    }
+
+    start = hostNow;
+    for(rpFrame& fr : frames) {
+        fr.time += start;
+    }
+    end = frames.back().time + RP_TAIL_US;
+
+    while(rpNext < frames.size() || hostNow < end) {
+        dmx_loop();
+    }
+    frameEnd(frames.size() - 1);
+
+    printf("Frames: %d, displays: %d\n", numFrames, (int)hostDisplays.size());
+    printf("Bus bytes per frame: %.1f avg, %lu max (budget %lu)\n",
+           (double)sumBytes / numFrames, (unsigned long)maxBytes, (unsigned long)budget);
+    printf("Transactions per frame: %.1f avg, %lu max\n",
+           (double)sumTrans / numFrames, (unsigned long)maxTrans);
+    if(golden && !record && goldBytes) {
+        printf("Bus bytes vs golden run: %+.1f%%\n", 100.0 * ((double)sumBytes - goldBytes) / goldBytes);
+    }
+    if(golden && !record) {
+        printf("Image differences: %d\n", numMismatch);
+    }
+    printf("Frames over budget: %d\n", numOver);
+
+    if(golden) fclose(golden);
+    if(traceOut) fclose(traceOut);
+
+    return (numMismatch || numOver) ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+#!/bin/sh
+# -------------------------------------------------------------------
+# CircuitSetup.us Time Circuits Display - DMX-controlled
+# (C) 2024 Thomas Winischhofer (A10001986)
+# All rights reserved.
+# -------------------------------------------------------------------
+#
+# Replay regression test (see tools/replay.cpp)
+#
+# Builds the replay with the firmware's build options, and checks
+# each capture in tools/captures (*.cap) against its golden images
+# (*.golden). Fails on any difference, and on any frame over the I2C
+# budget. The golden images are for the default build options in
+# tcd-DMX/tc_global.h.
+#
+# Run from the repository's top directory:
+#
+# sh tools/replay_test.sh        Check
+# sh tools/replay_test.sh -r     Re-record the golden images (after
+#                                an intended change of the output)
+# -------------------------------------------------------------------
+
+CXX=${CXX:-g++}
+BIN=${TMPDIR:-/tmp}/tcd-replay.$$
+MODE=-c
+[ "$1" = "-r" ] && MODE=-r
+
+trap 'rm -f "$BIN"' EXIT
+
+$CXX -std=gnu++11 -Itools/host -Itcd-DMX -o "$BIN" tools/replay.cpp tools/host/host.cpp \
+    tcd-DMX/tc_dmx.cpp tcd-DMX/clockdisplay.cpp tcd-DMX/speeddisplay.cpp \
+    tcd-DMX/rtc.cpp tcd-DMX/tc_log.cpp tcd-DMX/tc_userpers.cpp \
+    tcd-DMX/tc_cues.cpp tcd-DMX/tc_scenes.cpp tcd-DMX/tc_trace.cpp || exit 1
+
+rc=0
+for cap in tools/captures/*.cap; do
+    echo "== $cap"
+    "$BIN" $MODE "${cap%.cap}.golden" < "$cap" || rc=1
+done
+
+[ $rc = 0 ] && echo "Replay test passed" || echo "Replay test FAILED"
+exit $rc
@@ -0,0 +1,75 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Trace converter
+ *
+ * Converts a trace dump (see tcd-DMX/tc_trace.cpp) captured from
+ * Serial into Chrome trace JSON, to be loaded in chrome://tracing or
+ * https://ui.perfetto.dev. Lines other than the dump's are ignored,
+ * so the whole Serial log can be fed in. Each CPU core is a thread
+ * in the timeline; note that the two cores' cycle counters are not
+ * exactly in sync.
+ *
+ * Build and run on the host (from the repository's top directory):
+ *
+ * g++ -std=c++11 -o trace2json tools/trace2json.cpp
+ * ./trace2json < serial.log > trace.json
+ * -------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+int main()
+{
+    char     line[256], name[32], phase;
+    unsigned long mhz = 240, cycles, num;
+    unsigned int arg;
+    int      core;
+    uint32_t last[2] = { 0, 0 };
+    uint64_t wraps[2] = { 0, 0 };
+    bool     first = true;
+
+    printf("{\"traceEvents\":[\n");
+
+    while(fgets(line, sizeof(line), stdin)) {
+        if(sscanf(line, "trace,begin,%lu,%lu", &mhz, &num) == 2) {
+            if(!mhz) mhz = 240;
+            continue;
+        }
+        if(sscanf(line, "trace,%lu,%d,%31[^,],%c,%u", &cycles, &core, name, &phase, &arg) != 5)
+            continue;
+
+        core &= 1;
+
+        // Cycle counter is 32 bits
+        if((uint32_t)cycles < last[core]) wraps[core] += 1ULL << 32;
+        last[core] = (uint32_t)cycles;
+
+        printf("%s{\"name\":\"", first ? "" : ",\n");
+        if(!strcmp(name, "I2C")) {
+            printf("I2C 0x%02x", arg & 0x7f);
+        } else if(!strcmp(name, "Decode")) {
+            printf("Decode %u", arg);
+        } else {
+            printf("%s", name);
+        }
+        printf("\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", phase,
+               (double)(wraps[core] + cycles) / mhz, core);
+        if(phase == 'i') {
+            printf(",\"s\":\"t\"");
+        }
+        printf(",\"args\":{\"arg\":%u}}", arg);
+
+        first = false;
+    }
+
+    printf("\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    return 0;
+}